@@ -3,12 +3,43 @@
 #include <map>
 #include <set>
 #include <list>
+#include <queue>
 #include <tuple>
+#include <vector>
+#include <algorithm>
 #include <sys/stat.h>
 #include <limits.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <system_error>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <memory>
+#include <zlib.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <new>
+#include <linux/perf_event.h>
 #include "main.h"
 
 typedef map< char, set<char> > I_map;
+class ResultStore;
+
+// Buffer of palindromes in form (left_index, right_index, gap), optionally passing them on to a result store as they are found
+struct P_buffer : vector< tuple<int, int, int> > {
+    ResultStore* store = NULL;
+};
+
+// Engines available for finding palindromes (ENGINE_AUTO picks the most suitable for the given parameters)
+enum Engine { ENGINE_AUTO, ENGINE_GENERIC, ENGINE_FIXED, ENGINE_EXACT, ENGINE_SEED, ENGINE_DIAGONAL, ENGINE_CST, ENGINE_COMPRESSED };
+const char * engine_names[] = { "auto", "generic", "fixed", "exact", "seed", "diagonal", "cst", "compressed" };
 
 
 ///////////////////////////////////////////
@@ -58,6 +89,14 @@ void rmq_preprocess(INT * m, INT * v, INT n)
 //  BASIC HELPER FUNCTIONS  //
 //////////////////////////////
 
+// Returns the 64 bits of a bit vector (stored in words) starting at a given bit position
+static __inline uint64_t getBits64(const uint64_t* words, long int pos) {
+    long int w = pos >> 6;
+    int b = pos & 63;
+
+    return (b == 0) ? words[w] : (words[w] >> b) | (words[w + 1] << (64 - b));
+}
+
 // Checks if a filename exists
 int exist(const char *name) {
     struct stat buffer;
@@ -69,12 +108,29 @@ void usage() {
     fprintf ( stdout, "\n" );
     fprintf ( stdout, "  FLAG  PARAMETER       TYPE      DEFAULT         DESCRIPTION\n" );
     fprintf ( stdout, "  -f    input_file      <str>     input.fasta     Input filename (FASTA).\n" );
-    fprintf ( stdout, "  -s    seq_name        <str>     seq0            Input sequence name.\n");
+    fprintf ( stdout, "  -s    seq_name        <str>     seq0            Input sequence name (or names, separated by commas).\n");
     fprintf ( stdout, "  -m    min_len         <int>     10              Minimum length.\n");
     fprintf ( stdout, "  -M    max_len         <int>     100             Maximum length.\n");
     fprintf ( stdout, "  -g    max_gap         <int>     100             Maximum permissible gap.\n");
     fprintf ( stdout, "  -x    mismatches      <int>     0               Maximum permissible mismatches.\n");
-    fprintf ( stdout, "  -o    output_file     <str>     IUPACpal.out    Output filename.\n" );
+    fprintf ( stdout, "  -o    output_file     <str>     IUPACpal.out    Output filename (compressed with gzip if ending in .gz).\n" );
+    fprintf ( stdout, "  -e    engine          <str>     auto            Search engine (auto, generic, fixed, exact, seed, diagonal, cst, compressed).\n" );
+    fprintf ( stdout, "  -t    threads         <int>     1               Number of threads.\n");
+    fprintf ( stdout, "  --memory-limit        <int>     0               Memory for the index in MB (0 for no limit), above which it is built on disk.\n");
+    fprintf ( stdout, "  --results-memory      <int>     1024            Memory for palindromes found in MB (0 for no limit), above which they are sorted on disk.\n");
+    fprintf ( stdout, "  --scratch-dir         <str>     .               Directory for temporary index and result files.\n");
+    fprintf ( stdout, "  --index               <str>                     Prefix of index files, reused if present or written if not.\n");
+    fprintf ( stdout, "  --hugepages                                     Hold the index in huge pages.\n");
+    fprintf ( stdout, "  --numa                <str>     off             Index placement over NUMA nodes (off, interleave, replicate).\n");
+    fprintf ( stdout, "  --shard               <k/N>     1/1             Search only the k-th of N equal ranges of centres (merge with IUPACpal-merge).\n");
+    fprintf ( stdout, "  --checkpoint          <str>                     Checkpoint file, written as the output is (the index is stored alongside).\n");
+    fprintf ( stdout, "  --checkpoint-interval <int>     300             Least time between checkpoints in seconds.\n");
+    fprintf ( stdout, "  --resume                                        Resume the search from the checkpoint, if there is one.\n");
+    fprintf ( stdout, "  --max-memory          <int>     0               Memory for the whole search in MB (0 for no limit), planning how the index is held to fit.\n");
+    fprintf ( stdout, "  --profile             <str>                     Profile phases of the search, as a table on stderr ('stderr') or as JSON to a file.\n");
+    fprintf ( stdout, "  --stats                                         Count the work of scanning centres, as a table on stderr.\n");
+    fprintf ( stdout, "  --perf-counters                                 Add hardware performance counters of each phase to the profile.\n");
+    fprintf ( stdout, "  --trace               <str>                     Trace phases, records and chunks of centres on each thread, as a Chrome trace (JSON) file.\n");
     fprintf ( stdout, "\n" );
 }
 
@@ -150,885 +206,5952 @@ void print_array(string title, T seq, long int n, bool print_indices=false) {
 }
 
 
-////////////////////////////////////////////////
-//  IUPAC CHARACTER MATRIX CLASS & FUNCTIONS  //
-////////////////////////////////////////////////
+//////////////////////////////
+//  SCAN COUNTER FUNCTIONS  //
+//////////////////////////////
 
-// Inserts IUPAC characters mapping information into an STSL map
-void IUPAC_map_insert(I_map* IUPAC_map, int IUPAC_to_value[], char IUPAC_char, set<char> mapped_chars) {
-    static int index = 0;
-    IUPAC_map->insert( pair< char, set<char> > (IUPAC_char, mapped_chars) );
-    IUPAC_to_value[IUPAC_char] = index++;
-}
+// Number of buckets in the histograms of jumps and palindromes per centre, the last holding all larger counts
+#define STATS_BUCKETS 64
+
+// Counts of the work of scanning centres by the 'kangaroo method', kept by each thread scanning while counting
+struct ScanStats {
+    long int centres = 0;
+    long int lce_calls = 0;
+    long int rmq_queries = 0;
+    long int gap_mismatches = 0; // Mismatches found within the initial gap
+    long int arm_mismatches = 0; // Mismatches found beyond it, which count against the mismatches allowed
+    long int centres_without_starts = 0;
+    long int palindromes = 0;
+    long int truncated = 0;
+    long int jumps[STATS_BUCKETS] = {};
+    long int palindromes_per_centre[STATS_BUCKETS] = {};
+    ScanStats * next = NULL;
+};
 
-// Set a value in a matrix stored as a 1D contiguous sequence of memory
-template<typename T>
-void set_value_for_matrix(T* mtx_ptr, uint32_t ncols, uint32_t i, uint32_t j, T val) {
-    mtx_ptr[i + i * (ncols - 1) + j] = val;
-}
+// Whether scans are counted, with the counts of all threads (never freed, so they outlive their thread)
+bool scan_counting = false;
+atomic<ScanStats*> thread_scan_stats(NULL);
 
-// Get a value from a matrix stored as a 1D contiguous sequence of memory
-template<typename T>
-T get_value_from_matrix(T* mtx, uint32_t ncols, uint32_t i, uint32_t j) {
-    return mtx[i + i * (ncols - 1) + j];
+// Counts of the current thread
+thread_local ScanStats * scan_stats = NULL;
+
+// Returns the counts of the current thread, adding them to the counts of all threads the first time
+ScanStats* threadStats() {
+    if (scan_stats == NULL) {
+        scan_stats = new ScanStats();
+        scan_stats->next = thread_scan_stats.load();
+        while (!thread_scan_stats.compare_exchange_weak(scan_stats->next, scan_stats)) {}
+    }
+
+    return scan_stats;
 }
 
-// Class to store preprocessed information relating to the match status of IUPAC characters
-class MatchMatrix {
-    public:
-        static bool* match_matrix;
-        static int IUPAC_map_count;
-        static int* IUPAC_to_value;
+// Counts a centre scanned
+//
+// INPUT:
+// - Counts of the current thread
+// - Number of Longest Common Extensions made for the centre
+// - Number of valid start mismatches within the initial gap
+// - Number of palindromes found at the centre
+static __inline void countCentre(ScanStats* stats, int jumps, int starts, long int palindromes) {
+    stats->centres++;
+    stats->lce_calls += jumps;
+    stats->centres_without_starts += (starts == 0) ? 1 : 0;
+    stats->palindromes += palindromes;
+    stats->jumps[min(jumps, STATS_BUCKETS - 1)]++;
+    stats->palindromes_per_centre[min(palindromes, (long int) STATS_BUCKETS - 1)]++;
+}
 
-    static bool match(char a, char b) {
-        return get_value_from_matrix(match_matrix, IUPAC_map_count, IUPAC_to_value[a], IUPAC_to_value[b]);
+// Writes the counts of all threads, as a table or as the members of a JSON object
+//
+// INPUT:
+// - File to write to
+// - Whether to write JSON
+void writeStats(FILE * f, bool json) {
+    ScanStats total;
+
+    for (ScanStats * stats = thread_scan_stats.load(); stats != NULL; stats = stats->next) {
+        total.centres += stats->centres;
+        total.lce_calls += stats->lce_calls;
+        total.rmq_queries += stats->rmq_queries;
+        total.gap_mismatches += stats->gap_mismatches;
+        total.arm_mismatches += stats->arm_mismatches;
+        total.centres_without_starts += stats->centres_without_starts;
+        total.palindromes += stats->palindromes;
+        total.truncated += stats->truncated;
+
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            total.jumps[b] += stats->jumps[b];
+            total.palindromes_per_centre[b] += stats->palindromes_per_centre[b];
+        }
     }
-};
 
-bool* MatchMatrix::match_matrix;
-int MatchMatrix::IUPAC_map_count;
-int* MatchMatrix::IUPAC_to_value;
+    double centres = max(1L, total.centres);
 
+    vector< pair<const char *, long int> > counts = {
+        { "centres", total.centres }, { "lce_calls", total.lce_calls }, { "rmq_queries", total.rmq_queries },
+        { "mismatches_in_gap", total.gap_mismatches }, { "mismatches_after_gap", total.arm_mismatches },
+        { "centres_without_starts", total.centres_without_starts }, { "palindromes", total.palindromes }, { "palindromes_truncated", total.truncated }
+    };
 
-////////////////////////
-//  STRING FUNCTIONS  //
-////////////////////////
+    if (json) {
+        for (auto& count : counts) {
+            fprintf(f, "    \"%s\": %ld,\n", count.first, count.second);
+        }
 
-// Calculates the Longest Common Prefix array of a text and stores value in given variable LCP
-//
-// INPUT:
-// - Text
-// - Text length
-// - Suffix Array
-// - Longest Common Prefix data structure (empty)
-unsigned int LCParray(unsigned char *text, INT n, INT * SA, INT * invSA, INT * LCP)
-{
-    INT i = 0, j = 0;
-    LCP[0] = 0;
+        fprintf(f, "    \"jumps_per_centre\": %.4f,\n    \"palindromes_per_centre\": %.6f,\n", total.lce_calls / centres, total.palindromes / centres);
 
-    for (i = 0; i < n; i++) {
-        if (invSA[i] != 0) {
-            if ( i == 0) {
-                j = 0;
-            }
-            else {
-                j = (LCP[invSA[i-1]] >= 2) ? LCP[invSA[i-1]]-1 : 0;
-            }
+        for (int h = 0; h < 2; h++) {
+            long int * histogram = (h == 0) ? total.jumps : total.palindromes_per_centre;
+            fprintf(f, "    \"%s\": [", (h == 0) ? "jumps_histogram" : "palindromes_histogram");
 
-            while ( text[i+j] == text[SA[invSA[i]-1]+j] ) {
-                j++;
+            for (int b = 0; b < STATS_BUCKETS; b++) {
+                fprintf(f, "%s%ld", (b == 0) ? "" : ", ", histogram[b]);
             }
 
-            LCP[invSA[i]] = j;
+            fprintf(f, "]%s\n", (h == 0) ? "," : "");
         }
+
+        return;
     }
 
-    return 1;
+    fprintf(f, "\nScan counters:\n");
+
+    for (auto& count : counts) {
+        fprintf(f, "  %-24s %14ld\n", count.first, count.second);
+    }
+
+    fprintf(f, "  %-24s %14.4f\n  %-24s %14.6f\n", "jumps_per_centre", total.lce_calls / centres, "palindromes_per_centre", total.palindromes / centres);
+
+    if (total.centres == 0) {
+        fprintf(f, "  (centres are only counted by the generic, fixed, exact and seed engines)\n\n");
+        return;
+    }
+
+    for (int h = 0; h < 2; h++) {
+        long int * histogram = (h == 0) ? total.jumps : total.palindromes_per_centre;
+        fprintf(f, "  %s per centre (count:centres, the last %d or more):\n   ", (h == 0) ? "Jumps" : "Palindromes", STATS_BUCKETS - 1);
+
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            if (histogram[b] > 0) {
+                fprintf(f, " %d:%ld", b, histogram[b]);
+            }
+        }
+
+        fprintf(f, "\n");
+    }
+
+    fprintf(f, "\n");
 }
 
-// Returns the Longest Common Extension between position i and j (order of i, j input does not matter)
-//
-// INPUT:
-// - Indexes i and j
-// - Text length
-// - Inverse Suffix Array
-// - Longest Common Prefix Array data structure (filled)
-// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
-#ifdef _USE_NLOGN_RMQ
-// Using Type 1 RMQs
-unsigned int LCE(INT i, INT j, INT n, INT * invSA, INT * LCP, INT * A) {
-#else
-// Using Type 2 RMQs
-unsigned int LCE(INT i, INT j, INT n, INT * invSA, INT * LCP, rmq_succinct_sct<> rmq) {
-#endif
-    if (i == j) {
-        return n - i;
+
+/////////////////////////
+//  TRACING FUNCTIONS  //
+/////////////////////////
+
+// Number of spans each thread holds for --trace, its oldest being overwritten once it is full
+#define TRACE_EVENTS 16384
+
+// Span of time on one thread, with up to two named integer arguments (names are NULL when unused)
+struct TraceEvent {
+    const char * name;
+    const char * category;
+    const char * arg_names[2];
+    long int args[2];
+    int64_t start;
+    int64_t end;
+};
+
+// Spans of one thread, in a ring written only by that thread, kept in a list of all threads (never freed, so they outlive their
+// thread)
+struct TraceBuffer {
+    int tid;
+    const char * thread_name;
+    atomic<uint64_t> head;
+    TraceBuffer * next;
+    TraceEvent events[TRACE_EVENTS];
+};
+
+// Whether spans are traced, from when, and the spans of all threads
+bool tracing = false;
+chrono::steady_clock::time_point trace_start;
+atomic<TraceBuffer*> trace_buffers(NULL);
+atomic<int> trace_threads(0);
+
+// Names of the sequences whose records are traced, by record number
+mutex trace_lock;
+map<long int, string> trace_sequences;
+
+// Spans of the current thread
+thread_local TraceBuffer * trace_buffer = NULL;
+
+// Returns the time since tracing started, in nanoseconds
+int64_t traceClock() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - trace_start).count();
+}
+
+// Returns the spans of the current thread, adding them to the spans of all threads the first time
+TraceBuffer* threadTrace() {
+    if (trace_buffer == NULL) {
+        trace_buffer = new TraceBuffer();
+        trace_buffer->tid = trace_threads++;
+        trace_buffer->thread_name = "thread";
+        trace_buffer->head = 0;
+        trace_buffer->next = trace_buffers.load();
+        while (!trace_buffers.compare_exchange_weak(trace_buffer->next, trace_buffer)) {}
     }
 
-    INT a = invSA[i];
-    INT b = invSA[j];
-    INT c = 0;
+    return trace_buffer;
+}
 
-    if (a > b) {
-        c = a;
-        a = b;
-        b = c;
+// Names the current thread in the trace
+//
+// INPUT:
+// - Name (a string literal)
+void traceThread(const char * name) {
+    if (tracing) {
+        threadTrace()->thread_name = name;
     }
+}
 
-    #ifdef _USE_NLOGN_RMQ
-        return LCP[rmq(A, LCP, n, a, b)]; // Using Type 1 RMQs: rmq(a, b) does not include 'a' value in range
-    #else
-        return LCP[rmq(a + 1, b)]; // Using Type 2 RMQs: rmq(a, b) does include 'a' value in range
-    #endif
+// Registers the name of a sequence, given with the spans of its records
+//
+// INPUT:
+// - Record number of the sequence
+// - Sequence name
+void traceSequence(long int number, const string& name) {
+    if (tracing) {
+        lock_guard<mutex> guard(trace_lock);
+        trace_sequences[number] = name;
+    }
 }
 
-// Calculates a list of Longest Common Extensions, corresponding to 0, 1, 2, etc. allowed mismatches, up to maximum number of allowed mismatches
+// Adds a span that has ended to the spans of the current thread, overwriting its oldest once they are full
 //
 // EXTRA INFO:
-// - Only considers "real" mismatches (degenerate string mismatching according to IUPAC character matrix)
-// - Takes into account the matching possibility of non A, C, G, T/U characters
-// - Longest Common Extension calculated from positions i and j (order of i, j input does not matter)
-// - Only starts counting number of allowed mismatches that occur after the given initial gap, however earlier mismatches are still stored
-// - Should only be used after MatchMatrix has been instantiated with necessary data
+// - Only the thread writes to its ring, so the slot is written before the head moves on and no lock is needed
 //
 // INPUT:
-// - Text
-// - Indexes i and j
-// - Text length
-// - Inverse Suffix Array
-// - Longest Common Prefix Array (LCP)
-// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
-// - Maximum number of allowed mismatches
-// - Initial gap
-// - Data structure to store resulting mismatch locations
-#ifdef _USE_NLOGN_RMQ
-// Using Type 1 RMQs
-void realLCE_mismatches(unsigned char* text, INT i, INT j, INT n, INT * invSA, INT * LCP, INT * A, int mismatches, int initial_gap, list<int>* mismatch_locs) {
-#else
-// Using Type 2 RMQs
-void realLCE_mismatches(unsigned char* text, INT i, INT j, INT n, INT * invSA, INT * LCP, rmq_succinct_sct<> rmq, int mismatches, int initial_gap, list<int>* mismatch_locs) {
-#endif
-    if ( i == j ) {
-        mismatch_locs->push_back( n - i );
-    }
-    else {
-        int real_lce = 0;
+// - Span
+void traceEvent(const TraceEvent& event) {
+    TraceBuffer * buffer = threadTrace();
+    uint64_t head = buffer->head.load(memory_order_relaxed);
+    buffer->events[head % TRACE_EVENTS] = event;
+    buffer->head.store(head + 1, memory_order_release);
+}
 
-        while (mismatches >= 0) {
-            #ifdef _USE_NLOGN_RMQ
-            real_lce = real_lce + LCE(i + real_lce, j + real_lce, n, invSA, LCP, A);
-            #else
-            real_lce = real_lce + LCE(i + real_lce, j + real_lce, n, invSA, LCP, rmq);
-            #endif
+// Span of time on the current thread, from construction to destruction (or until it ends), added to its spans while tracing
+//
+// EXTRA INFO:
+// - Names and categories must be string literals (or otherwise outlive the search), as only pointers to them are kept
+// - Costs two clock reads and a write to the ring of the thread while tracing, and a branch otherwise
+class TraceScope {
+    TraceEvent event;
+    bool active = false;
+
+public:
+    TraceScope(const char * name, const char * category, const char * arg_name = NULL, long int arg = 0, const char * arg_name_2 = NULL, long int arg_2 = 0) {
+        if (tracing) {
+            active = true;
+            event.name = name;
+            event.category = category;
+            event.arg_names[0] = arg_name;
+            event.arg_names[1] = arg_name_2;
+            event.args[0] = arg;
+            event.args[1] = arg_2;
+            event.start = traceClock();
+        }
+    }
 
-            if ( i + real_lce >= (n / 2) or j + real_lce >= n ) {
-                break;
-            }
+    ~TraceScope() {
+        end();
+    }
 
-            char s1 = text[i + real_lce];
-            char s2 = text[j + real_lce];
+    // Ends the span before the scope does
+    void end() {
+        if (active) {
+            active = false;
+            event.end = traceClock();
+            traceEvent(event);
+        }
+    }
+};
 
-            if ( !MatchMatrix::match(s1, s2) ) {
+// Adds a span without arguments, from a time until now, to the spans of the current thread
+//
+// INPUT:
+// - Name (a string literal)
+// - Category (a string literal)
+// - Start of the span, from traceClock()
+void traceSpan(const char * name, const char * category, int64_t start) {
+    TraceEvent event = { name, category, { NULL, NULL }, { 0, 0 }, start, traceClock() };
+    traceEvent(event);
+}
 
-                mismatch_locs->push_back( real_lce );
-                if (real_lce >= initial_gap) {
-                    mismatches--;
-                }
-            }
+// Starts tracing spans, from now
+void startTrace() {
+    trace_start = chrono::steady_clock::now();
+    tracing = true;
+    traceThread("main");
+}
 
-            real_lce++;
+// Writes a string as a JSON string
+//
+// INPUT:
+// - File to write to
+// - String
+void writeJsonString(FILE * f, const string& text) {
+    fputc('"', f);
+
+    for (unsigned char ch : text) {
+        if (ch == '"' or ch == '\\') {
+            fprintf(f, "\\%c", ch);
+        } else if (ch < 0x20) {
+            fprintf(f, "\\u%04x", ch);
+        } else {
+            fputc(ch, f);
         }
     }
+
+    fputc('"', f);
 }
 
-// Finds all inverted repeats (palindromes) with given parameters and adds them to an output set
+// Writes the spans of all threads as a Chrome trace (JSON trace events, opened by chrome://tracing or Perfetto), returning
+// whether it could be written
+//
+// EXTRA INFO:
+// - Must only be called once no thread adds spans
 //
 // INPUT:
-// - Data structure (set of integer 3-tuples) to store palindromes in form (left_index, right_index, gap)
-// - S = text + '$' + complement(reverse(text) + '#'
-// - Length of S
-// - Text length
-// - Inverse Suffix Array
-// - Longest Common Prefix Array (LCP)
-// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
-// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap)
-#ifdef _USE_NLOGN_RMQ
-// Using Type 1 RMQs
-void addPalindromes(set<tuple<int, int, int>>* palindromes, unsigned char* S, int S_n, int n, INT * invSA, INT * LCP, INT * A, tuple<int, int, int, int> params) {
-#else
-// Using Type 2 RMQs
-void addPalindromes(set<tuple<int, int, int>>* palindromes, unsigned char* S, int S_n, int n, INT * invSA, INT * LCP, rmq_succinct_sct<> rmq, tuple<int, int, int, int> params) {
-#endif
-    // Retrieve parameters from tuple
-    int min_len = get<0>(params);
-    int max_len = get<1>(params);
-    int mismatches = get<2>(params);
-    int max_gap = get<3>(params);
-
-    // Cycle through possible centres of text from left to right
-    for (double c = 0; c <= (n - 1); c += 0.5 ) {
-        // Determine if value of centre corresponds to an odd or even palindrome
-        bool isOdd = (trunc(c) == c);
-
-        // Strategically choose i and j to determine maximum extension with text
-        int i, j;
+// - Filename
+bool writeTrace(string filename) {
+    FILE * f = fopen(filename.c_str(), "w");
 
-        if (isOdd) {
-            i = int(c + 1.0);
-            j = int(2.0 * n + 1.0 - c);
-        } else {
-            i = int(c + 0.5);
-            j = int(2.0 * n + 1.0 - (c + 0.5));
-        }
+    if (f == NULL) {
+        return false;
+    }
 
-        // Calculate initial number of characters ignored when performing Longest Common Extensions to determine palindromes
-        int initial_gap;
+    lock_guard<mutex> guard(trace_lock);
+    uint64_t dropped = 0;
+    bool first = true;
 
-        if (max_gap % 2 == 1) {
-            initial_gap = (max_gap - 1) / 2;
-        }
-        else {
-            if (isOdd) {
-                initial_gap = (max_gap - 2) / 2;
-            } else {
-                initial_gap = max_gap / 2;
-            }
-        }
+    fprintf(f, "{\n  \"traceEvents\": [");
 
-        // Calculate list of relevant mismatch locations when performing Longest Common Extensions in 'kangaroo method' style
-        list<int> mismatch_locs;
+    for (TraceBuffer * buffer = trace_buffers.load(); buffer != NULL; buffer = buffer->next) {
+        uint64_t head = buffer->head.load(memory_order_acquire);
+        uint64_t oldest = (head > TRACE_EVENTS) ? head - TRACE_EVENTS : 0;
+        dropped += oldest;
 
-        #ifdef _USE_NLOGN_RMQ
-            realLCE_mismatches(S, i, j, S_n, invSA, LCP, A, mismatches, initial_gap, &mismatch_locs);
-        #else
-            realLCE_mismatches(S, i, j, S_n, invSA, LCP, rmq, mismatches, initial_gap, &mismatch_locs);
-        #endif
+        // Threads are named, and ordered as they first traced a span
+        fprintf(f, "%s\n    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": { \"name\": \"%s\" } },", first ? "" : ",",
+                buffer->tid, buffer->thread_name);
+        fprintf(f, "\n    { \"name\": \"thread_sort_index\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": { \"sort_index\": %d } }", buffer->tid, buffer->tid);
+        first = false;
 
-        // Always set -1 as a mismatch location
-        mismatch_locs.push_front(-1);
+        for (uint64_t e = oldest; e < head; e++) {
+            TraceEvent& event = buffer->events[e % TRACE_EVENTS];
 
-        // Create data structures to store valid start and end mismatch locations alongside an ID value (mismatch_location, mismatch_id)
-        list<pair<int, int>> valid_start_locs, valid_end_locs;
+            fprintf(f, ",\n    { \"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {",
+                    event.name, event.category, buffer->tid, event.start / 1000.0, (event.end - event.start) / 1000.0);
 
-        // Determine list of valid start and end mismatch locations (that could mark the potential start or end of a palindrome)
-        int mismatch_id = 0;
-        for (list<int>::iterator it = mismatch_locs.begin(); it != mismatch_locs.end(); ++it){
-            if (next(it) != mismatch_locs.end() and *next(it) != *it + 1) {
-                valid_start_locs.push_back(pair<int, int> (*it, mismatch_id));
+            for (int a = 0; a < 2 and event.arg_names[a] != NULL; a++) {
+                fprintf(f, "%s \"%s\": %ld", (a == 0) ? "" : ",", event.arg_names[a], event.args[a]);
             }
 
-            if (it != mismatch_locs.begin() and *prev(it) != *it - 1) {
-                valid_end_locs.push_back(pair<int, int> (*it, mismatch_id));
+            // Spans of a record name its sequence
+            if (event.arg_names[0] != NULL and strcmp(event.arg_names[0], "record") == 0 and trace_sequences.count(event.args[0]) > 0) {
+                fprintf(f, ", \"sequence\": ");
+                writeJsonString(f, trace_sequences[event.args[0]]);
             }
 
-            mismatch_id++;
+            fprintf(f, " } }");
+        }
+    }
+
+    fprintf(f, "\n  ],\n  \"displayTimeUnit\": \"ms\",\n  \"otherData\": { \"dropped_events\": %lu }\n}\n", (unsigned long) dropped);
+
+    return fclose(f) == 0;
+}
+
+
+///////////////////////////
+//  PROFILING FUNCTIONS  //
+///////////////////////////
+
+// Phases of a search timed by --profile
+enum Phase { PHASE_READ, PHASE_PLAN, PHASE_TEXT, PHASE_SUFFIX_ARRAY, PHASE_INVERSE_SUFFIX_ARRAY, PHASE_LCP, PHASE_RMQ, PHASE_INDEX_FILES,
+             PHASE_EXTERNAL_INDEX, PHASE_COMPRESSED_INDEX, PHASE_SUFFIX_TREE, PHASE_SCAN, PHASE_FORMAT, PHASE_COMPRESS, PHASE_WRITE, PHASES };
+
+// Names of the phases, as reported
+const char * phase_names[PHASES] = { "read", "plan", "text", "suffix_array", "inverse_suffix_array", "lcp", "rmq", "index_files",
+                                     "external_index", "compressed_index", "suffix_tree", "scan", "format", "compress", "write" };
+
+// Events counted in each phase by --perf-counters, the hardware events in one group and the software events in another
+enum PerfEvent { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_TLB_MISSES, PERF_BRANCH_MISSES, PERF_PAGE_FAULTS,
+                 PERF_CONTEXT_SWITCHES, PERF_EVENTS };
+
+// Names of the events, as reported
+const char * perf_names[PERF_EVENTS] = { "cycles", "instructions", "cache_misses", "dtlb_misses", "branch_misses", "page_faults",
+                                         "context_switches" };
+
+// Type and configuration of each event, for perf_event_open
+const uint32_t perf_types[PERF_EVENTS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE,
+                                           PERF_TYPE_SOFTWARE, PERF_TYPE_SOFTWARE };
+const uint64_t perf_configs[PERF_EVENTS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                             PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                                             PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS, PERF_COUNT_SW_CONTEXT_SWITCHES };
+
+// Totals of a phase over a search
+struct PhaseTotals {
+    long int count = 0;
+    double seconds = 0.0;
+    long int rss_delta = 0;
+    long int rss_peak = 0;
+    long int allocations = 0;
+    long int allocated = 0;
+    double perf[PERF_EVENTS] = {};
+};
+
+// Allocations made by a thread in each phase, kept in a list of all threads (never freed, so they outlive their thread)
+struct ThreadAllocations {
+    long int allocations[PHASES] = {};
+    long int allocated[PHASES] = {};
+    ThreadAllocations * next = NULL;
+};
+
+// Whether phases are profiled, with the totals of each, and the allocations of all threads
+bool profiling = false;
+mutex profile_lock;
+PhaseTotals phase_totals[PHASES];
+atomic<ThreadAllocations*> thread_allocations(NULL);
+int statm_fd = -1;
+
+// Phase the current thread is in (-1 outside all phases), and its allocations
+thread_local int thread_phase = -1;
+thread_local ThreadAllocations * thread_allocated = NULL;
+
+// Counts an allocation in the phase of the current thread
+//
+// EXTRA INFO:
+// - Called by operator new while profiling, so it allocates with calloc itself
+//
+// INPUT:
+// - Size of the allocation, in bytes
+void countAllocation(size_t size) {
+    if (thread_phase < 0) {
+        return;
+    }
+
+    if (thread_allocated == NULL) {
+        thread_allocated = (ThreadAllocations*) calloc(1, sizeof(ThreadAllocations));
+
+        if (thread_allocated == NULL) {
+            return;
         }
 
-        // Optional printing of mismatch locations relative to centre, valid start locations and valid end locations
-        #ifdef _DIAGNOSTICS
-            cout << "centre = " << c << "\n";
-            cout << "mismatches: " << "\t";
-            cout << "[ ";
-            for (list<int>::iterator it = mismatch_locs.begin(); it != mismatch_locs.end(); ++it){
-                cout << *it << " ";
+        thread_allocated->next = thread_allocations.load();
+        while (!thread_allocations.compare_exchange_weak(thread_allocated->next, thread_allocated)) {}
+    }
+
+    thread_allocated->allocations[thread_phase]++;
+    thread_allocated->allocated[thread_phase] += size;
+}
+
+// Returns the resident set size of the process, in bytes (0 if it cannot be read)
+long int residentBytes() {
+    char buffer[64];
+    ssize_t length = (statm_fd == -1) ? -1 : pread(statm_fd, buffer, sizeof(buffer) - 1, 0);
+
+    if (length <= 0) {
+        return 0;
+    }
+
+    buffer[length] = '\0';
+
+    // statm gives the total program size, then the resident set size, in pages
+    long int size, resident;
+
+    if (sscanf(buffer, "%ld %ld", &size, &resident) != 2) {
+        return 0;
+    }
+
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Starts profiling the phases of the search
+void startProfile() {
+    statm_fd = open("/proc/self/statm", O_RDONLY);
+    profiling = true;
+}
+
+// Returns the phase the current thread is in, for threads working on its behalf to enter
+int currentPhase() {
+    return thread_phase;
+}
+
+// Events of a thread, opened the first time it reads them, as a group of hardware events and a group of software events
+//
+// EXTRA INFO:
+// - Events count only while the thread runs, and only in user space for hardware events (allowed by the default
+//   kernel.perf_event_paranoid of 2)
+// - Closed as the thread exits
+struct PerfGroups {
+    bool opened = false;
+    int fd[PERF_EVENTS]; // Each event, or -1 if it could not be opened
+    int slot[PERF_EVENTS]; // Position of each event within its group
+    int leader[2] = { -1, -1 };
+    int members[2] = { 0, 0 };
+
+    ~PerfGroups() {
+        for (int e = 0; opened and e < PERF_EVENTS; e++) {
+            if (fd[e] != -1) {
+                close(fd[e]);
             }
-            cout << "]" << endl;
-            cout << "starts: " << "\t";
-            cout << "[ ";
-            for (list<pair<int, int>>::iterator it = valid_start_locs.begin(); it != valid_start_locs.end(); ++it){
-                cout << "(" << it->first << ", " << it->second << ") ";
+        }
+    }
+};
+
+// Values of the events of a thread at a point in time, with the time each group was enabled and running (less than enabled
+// when more events are opened than the processor can count at once, and the kernel takes turns counting them)
+struct PerfReading {
+    uint64_t value[PERF_EVENTS] = {};
+    uint64_t enabled[2] = {};
+    uint64_t running[2] = {};
+};
+
+// Whether events are counted, which events any thread could open, and why the first that could not be opened could not
+bool perf_counting = false;
+atomic<bool> perf_opened[PERF_EVENTS];
+string perf_error = "";
+
+thread_local PerfGroups perf_groups;
+
+// Opens the events of the current thread, as far as the kernel allows
+void openPerfGroups() {
+    perf_groups.opened = true;
+
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        int g = (perf_types[e] == PERF_TYPE_SOFTWARE) ? 1 : 0;
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_types[e];
+        attr.config = perf_configs[e];
+        attr.exclude_kernel = (g == 0) ? 1 : 0;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, perf_groups.leader[g], 0);
+        int error = errno; // Before locking and building the message may change it
+        perf_groups.fd[e] = fd;
+
+        if (fd == -1) {
+            lock_guard<mutex> guard(profile_lock);
+            if (perf_error == "") {
+                perf_error = string(perf_names[e]) + ": " + strerror(error);
+
+                if (error == EACCES or error == EPERM) {
+                    perf_error += " (see /proc/sys/kernel/perf_event_paranoid)";
+                }
+                if (error == ENOENT or error == EOPNOTSUPP) {
+                    perf_error += " (no such counter on this processor or virtual machine)";
+                }
             }
-            cout << "]" << endl;
+            continue;
+        }
+
+        if (perf_groups.leader[g] == -1) {
+            perf_groups.leader[g] = fd;
+        }
+
+        perf_groups.slot[e] = perf_groups.members[g]++;
+        perf_opened[e] = true;
+    }
+}
+
+// Reads the events of the current thread, opening them the first time
+//
+// INPUT:
+// - Reading to fill
+void readPerf(PerfReading* reading) {
+    if (!perf_groups.opened) {
+        openPerfGroups();
+    }
+
+    for (int g = 0; g < 2; g++) {
+        // Number of events, time enabled, time running, then the value of each event
+        uint64_t values[3 + PERF_EVENTS];
 
-            cout << "ends: " << "\t\t";
-            cout << "[ ";
-            for (list<pair<int, int>>::iterator it = valid_end_locs.begin(); it != valid_end_locs.end(); ++it){
-                cout << "(" << it->first << ", " << it->second << ") ";
+        if (perf_groups.leader[g] == -1 or read(perf_groups.leader[g], values, sizeof(values)) <= 0) {
+            continue;
+        }
+
+        reading->enabled[g] = values[1];
+        reading->running[g] = values[2];
+
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            if (perf_groups.fd[e] != -1 and (perf_types[e] == PERF_TYPE_SOFTWARE) == (g == 1)) {
+                reading->value[e] = values[3 + perf_groups.slot[e]];
             }
-            cout << "]" << endl;
+        }
+    }
+}
 
-            cout << endl;
-        #endif
+// Adds the events counted between two readings to the totals of a phase, scaled up for the time their group was not counted
+//
+// INPUT:
+// - Totals of the phase
+// - Reading at the start of the phase
+// - Reading at its end
+void addPerf(PhaseTotals* totals, const PerfReading& start, const PerfReading& end) {
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        int g = (perf_types[e] == PERF_TYPE_SOFTWARE) ? 1 : 0;
+        uint64_t running = end.running[g] - start.running[g];
+
+        if (running > 0) {
+            totals->perf[e] += (double) (end.value[e] - start.value[e]) * (end.enabled[g] - start.enabled[g]) / running;
+        }
+    }
+}
 
-        // Check if valid start and end mismatch locations have been found
-        if ( !valid_start_locs.empty() and !valid_end_locs.empty() ) {
-            list<pair<int, int>>::iterator start_it = valid_start_locs.begin();
-            list<pair<int, int>>::iterator end_it = valid_end_locs.begin();
+// Starts counting events in each phase, returning whether any can be counted
+bool startPerfCounters() {
+    perf_counting = true;
 
-            int mismatch_diff, left, right, gap;
-        	int start_mismatch, end_mismatch;
+    PerfReading reading;
+    readPerf(&reading);
 
-            // Loop while both start and end mismatch locations have not reached the end of their respective lists
-            while( start_it != valid_start_locs.end() and end_it != valid_end_locs.end()) {
-                // Count the difference in mismatches between the start and end location
-                mismatch_diff = end_it->second - start_it->second - 1;
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        if (perf_opened[e]) {
+            return true;
+        }
+    }
 
-                // While mismatch difference is too large, move start location to the right until mismatch difference is within acceptable bound
-                while (mismatch_diff > mismatches) {
-                    start_it = next(start_it);
-                    mismatch_diff = end_it->second - start_it->second - 1;
-                }
+    perf_counting = false;
+    return false;
+}
 
-                // While mismatch difference is within acceptable bound, move end location to the right until mismatch difference becomes unacceptable
-                while (mismatch_diff <= mismatches and end_it != valid_end_locs.end()) {
-                    end_it = next(end_it);
-                    mismatch_diff = end_it->second - start_it->second - 1;
-                }
+// Part of a phase done by a thread working on behalf of the thread in it, from construction to destruction, adding the events
+// of the thread to the totals of the phase while counting them (its time is that of the phase)
+class WorkerPhase {
+    int phase;
+    int64_t trace_begin;
+    PerfReading start;
 
-                start_mismatch = start_it->first; // Pick the current start mismatch
-                end_mismatch = prev(end_it)->first; // Pick the end mismatch directly after the current end mismatch
+public:
+    WorkerPhase(int worker_phase) : phase(worker_phase) {
+        thread_phase = phase;
 
-                // Skip this iteration if the start mismatch chosen is such that the gap is not within the acceptable bound
-                if (start_mismatch >= initial_gap ) {
-                	break;
-                }
+        if (tracing) {
+            trace_begin = traceClock();
+        }
 
-                // Optionally view diagnostics information
-                #ifdef _DIAGNOSTICS
-                    cout << "(start_mismatch, end_mismatch) = " << start_mismatch << " " << end_mismatch << endl;
-                #endif
+        if (perf_counting and phase >= 0) {
+            readPerf(&start);
+        }
+    }
 
-                // Set left, right indexes and gap of potential palindrome, according to chosen start and end mismatch
-                if (isOdd) {
-	                left = int(c - end_mismatch);
-	                right = int(c + end_mismatch);
-	                gap = 2 * (start_mismatch + 1) + 1;
-	            }
-	            else {
-	                left = int(c - 0.5 - (end_mismatch - 1.0));
-	                right = int(c + 0.5 + (end_mismatch - 1.0));
-	                gap = 2 * (start_mismatch + 1);
-	            }
+    ~WorkerPhase() {
+        if (tracing and phase >= 0) {
+            traceSpan(phase_names[phase], "phase", trace_begin);
+        }
 
-                // Optionally view diagnostics information
-                #ifdef _DIAGNOSTICS
-                    cout << "(left, gap, right) = " << left << " " << right << " " << gap << endl << endl;
-                #endif
+        if (perf_counting and phase >= 0) {
+            PerfReading end;
+            readPerf(&end);
+
+            lock_guard<mutex> guard(profile_lock);
+            addPerf(&phase_totals[phase], start, end);
+        }
+    }
+};
+
+// Phase of a search on the current thread, from construction to destruction (or until it ends or is followed by the next),
+// adding its time and change in resident set size to the totals of the phase while profiling
+//
+// EXTRA INFO:
+// - Phases may nest (the compressed index and suffix tree are built within the scan); allocations count in the innermost
+// - The peak is that of the process by the end of the phase, so the first phase reaching the peak of the search raised it
+// - Costs two clock reads, two reads of /proc/self/statm and a getrusage while profiling (and four reads of events while
+//   counting them), and a branch otherwise
+// - Is also traced as a span of the thread while tracing, whether profiling or not
+class PhaseScope {
+    int phase;
+    int outer;
+    bool entered = false;
+    bool active = false;
+    bool traced = false;
+    long int rss;
+    chrono::steady_clock::time_point start;
+    int64_t trace_begin;
+    PerfReading perf_start;
+
+    void begin() {
+        if (profiling or tracing) {
+            entered = true;
+            outer = thread_phase;
+            thread_phase = phase;
+        }
+
+        if (tracing) {
+            traced = true;
+            trace_begin = traceClock();
+        }
+
+        if (profiling) {
+            active = true;
+            rss = residentBytes();
+            start = chrono::steady_clock::now();
+
+            if (perf_counting) {
+                readPerf(&perf_start);
+            }
+        }
+    }
+
+public:
+    PhaseScope(Phase scope_phase) : phase(scope_phase) {
+        begin();
+    }
+
+    ~PhaseScope() {
+        end();
+    }
+
+    // Ends the phase, and starts the one following it
+    void next(Phase next_phase) {
+        end();
+        phase = next_phase;
+        begin();
+    }
+
+    // Ends the phase before the scope does
+    void end() {
+        if (traced) {
+            traced = false;
+            traceSpan(phase_names[phase], "phase", trace_begin);
+        }
+
+        if (active) {
+            PerfReading perf_end;
+
+            if (perf_counting) {
+                readPerf(&perf_end);
+            }
+
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            long int rss_end = residentBytes();
+
+            struct rusage resources;
+            getrusage(RUSAGE_SELF, &resources);
+
+            active = false;
+
+            lock_guard<mutex> guard(profile_lock);
+            PhaseTotals& totals = phase_totals[phase];
+            totals.count++;
+            totals.seconds += seconds;
+            totals.rss_delta += rss_end - rss;
+            totals.rss_peak = max(totals.rss_peak, resources.ru_maxrss * 1024);
+
+            if (perf_counting) {
+                addPerf(&totals, perf_start, perf_end);
+            }
+        }
+
+        if (entered) {
+            entered = false;
+            thread_phase = outer;
+        }
+    }
+};
+
+// Writes the totals of all phases entered, as a table to stderr or as JSON to a file, returning whether it could be written
+//
+// INPUT:
+// - 'stderr', or the name of the JSON file
+// - Wall time of the whole search, in seconds
+bool writeProfile(string destination, double seconds) {
+    lock_guard<mutex> guard(profile_lock);
+
+    for (ThreadAllocations * thread = thread_allocations.load(); thread != NULL; thread = thread->next) {
+        for (int p = 0; p < PHASES; p++) {
+            phase_totals[p].allocations += thread->allocations[p];
+            phase_totals[p].allocated += thread->allocated[p];
+            thread->allocations[p] = 0;
+            thread->allocated[p] = 0;
+        }
+    }
+
+    struct rusage resources;
+    getrusage(RUSAGE_SELF, &resources);
+
+    const double MB = 1024.0 * 1024.0;
+
+    if (destination == "stderr") {
+        fprintf(stderr, "\nProfile: %.3f s, peak RSS %.1f MB\n", seconds, resources.ru_maxrss / 1024.0);
+        fprintf(stderr, "  %-22s %8s %12s %14s %12s %12s %14s\n", "phase", "count", "seconds", "rss_delta_mb", "peak_rss_mb", "allocations", "allocated_mb");
+
+        for (int p = 0; p < PHASES; p++) {
+            PhaseTotals& totals = phase_totals[p];
+
+            if (totals.count > 0) {
+                fprintf(stderr, "  %-22s %8ld %12.3f %14.1f %12.1f %12ld %14.1f\n", phase_names[p], totals.count, totals.seconds,
+                        totals.rss_delta / MB, totals.rss_peak / MB, totals.allocations, totals.allocated / MB);
+            }
+        }
 
-                // Check that potential palindrome is not too short
-	            if ((right - left + 1 - gap) / 2 >= min_len) {
-                    // Check that potentialinput_file palindrome is not too long
-                    if ((right - left + 1 - gap) / 2 <= max_len) {
-                        // Palindrome is not too long, so add to output
-                        palindromes->insert(tuple<int, int, int>(left, right, gap));
+        if (perf_counting) {
+            fprintf(stderr, "\nPerformance counters, summed over threads ('-' where not counted):\n  %-22s", "phase");
+
+            for (int e = 0; e < PERF_EVENTS; e++) {
+                fprintf(stderr, " %16s", perf_names[e]);
+            }
+
+            fprintf(stderr, " %8s\n", "ipc");
+
+            for (int p = 0; p < PHASES; p++) {
+                PhaseTotals& totals = phase_totals[p];
+
+                if (totals.count > 0) {
+                    fprintf(stderr, "  %-22s", phase_names[p]);
+
+                    for (int e = 0; e < PERF_EVENTS; e++) {
+                        if (perf_opened[e]) fprintf(stderr, " %16.0f", totals.perf[e]); else fprintf(stderr, " %16s", "-");
                     }
-                    else {
-                        // Palindrome is too long, so attempt truncation
-                        int prev_end_mismatch = prev(prev(end_it))->first;
-                        int mismatch_gap = end_mismatch - prev_end_mismatch - 1;
-                        int overshoot = ( (right - left + 1 - gap) / 2 ) - max_len;
-
-                        // Check if truncation results in the potential palindrome ending in a mismatch
-                        if (overshoot != mismatch_gap) {
-                            // Potential palindrome does not end in a mismatch, so add to output
-                            palindromes->insert(tuple<int, int, int>(left + overshoot, right - overshoot, gap));
-                        }
-                        else {
-                            // Potential palindrome does end in a mismatch, so truncate an additional 1 character either side then add to output
-                            palindromes->insert(tuple<int, int, int>(left + overshoot + 1, right - overshoot - 1, gap));
-                        }
+
+                    if (perf_opened[PERF_CYCLES] and perf_opened[PERF_INSTRUCTIONS] and totals.perf[PERF_CYCLES] > 0) {
+                        fprintf(stderr, " %8.2f\n", totals.perf[PERF_INSTRUCTIONS] / totals.perf[PERF_CYCLES]);
+                    } else {
+                        fprintf(stderr, " %8s\n", "-");
                     }
-	            }
+                }
+            }
 
-                // Go to next start mismatch in list and loop
-                start_it = next(start_it);
+            if (perf_error != "") {
+                fprintf(stderr, "  Not all events could be counted: %s\n", perf_error.c_str());
             }
         }
 
-        #ifdef _DIAGNOSTICS
-            cout << "----------------" << endl << endl;
-        #endif
+        fprintf(stderr, "\n");
+        return true;
     }
-}
 
+    FILE * f = fopen(destination.c_str(), "w");
 
-//////////////////////
-//  MAIN EXECUTION  //
-//////////////////////
+    if (f == NULL) {
+        return false;
+    }
 
-int main(int argc, char* argv[]) {
+    fprintf(f, "{\n  \"seconds\": %.6f,\n  \"peak_rss_mb\": %.1f,\n  \"phases\": [", seconds, resources.ru_maxrss / 1024.0);
 
-    ///////////////////////
-    //  REQUEST OPTIONS  //
-    ///////////////////////
+    bool first = true;
 
-    // Default parameters
-    string input_file = "input.fasta";
-    string seq_name = "seq0";
-    int min_len = 10;
-    int max_len = 100;
-    int max_gap = 100;
-    int mismatches = 0;
-    string output_file = "IUPACpal.out";
+    for (int p = 0; p < PHASES; p++) {
+        PhaseTotals& totals = phase_totals[p];
 
-    // Parse command line arguments
-    int c;
-    while( ( c = getopt (argc, argv, "f:s:m:M:g:x:o:") ) != -1 )
-    {
-        switch(c)
-        {
-            case 'f':
-                if(optarg) input_file = optarg;
-                break;
-            case 's':
-                if(optarg) seq_name = optarg;
-                break;
-            case 'm':
-                if(optarg) min_len = std::atoi(optarg);
-                break;
-            case 'M':
-                if(optarg) max_len = std::atoi(optarg);
-                break;
-            case 'g':
-                if(optarg) max_gap = std::atoi(optarg);
-                break;
-            case 'x':
-                if(optarg) mismatches = std::atoi(optarg);
-                break;
-            case 'o':
-                if(optarg) output_file = optarg;
-                break;
+        if (totals.count > 0) {
+            fprintf(f, "%s\n    { \"phase\": \"%s\", \"count\": %ld, \"seconds\": %.6f, \"rss_delta_mb\": %.1f, \"peak_rss_mb\": %.1f, "
+                    "\"allocations\": %ld, \"allocated_mb\": %.1f", first ? "" : ",", phase_names[p], totals.count, totals.seconds,
+                    totals.rss_delta / MB, totals.rss_peak / MB, totals.allocations, totals.allocated / MB);
+
+            // Events not counted are null
+            if (perf_counting) {
+                for (int e = 0; e < PERF_EVENTS; e++) {
+                    if (perf_opened[e]) fprintf(f, ", \"%s\": %.0f", perf_names[e], totals.perf[e]); else fprintf(f, ", \"%s\": null", perf_names[e]);
+                }
+
+                if (perf_opened[PERF_CYCLES] and perf_opened[PERF_INSTRUCTIONS] and totals.perf[PERF_CYCLES] > 0) {
+                    fprintf(f, ", \"ipc\": %.4f", totals.perf[PERF_INSTRUCTIONS] / totals.perf[PERF_CYCLES]);
+                } else {
+                    fprintf(f, ", \"ipc\": null");
+                }
+            }
+
+            fprintf(f, " }");
+            first = false;
         }
     }
-;
-    ///////////////////////
-    //  VERIFY OPTIONS   //
-    ///////////////////////
 
-    // Check input file exists, exit if it does not
-    if (!exist(input_file.c_str())) {  usage(); cout << "Error: File '" + input_file + "' not found." << endl; return -1; }
+    fprintf(f, "\n  ]");
 
-    // Read input file
-    ifstream input( input_file );
-    string name = "";
-    string contents = "";
-    bool found_seq = false;
+    if (perf_counting and perf_error != "") {
+        fprintf(f, ",\n  \"perf_error\": \"%s\"", perf_error.c_str());
+    }
 
-    // Parse file line by line
-    for( string line; getline( input, line ); )
-    {
-        int line_length = line.length();
+    if (scan_counting) {
+        fprintf(f, ",\n  \"stats\": {\n");
+        writeStats(f, true);
+        fprintf(f, "  }");
+    }
 
-        // Look for sequence name
-        if (found_seq == false) {
-            if (line_length > 0 && line[0] == '>') {
-                int i = 1;
-                while ( i < line_length && line[i] == ' ') {
-                    i++;
+    fprintf(f, "\n}\n");
+
+    return fclose(f) == 0;
+}
+
+// Allocations through new are counted in the phase they are made in while profiling
+//
+// EXTRA INFO:
+// - Only the plain forms are replaced, as the array and sized forms call them
+// - Retries through the new handler as the usual allocator does, throwing bad_alloc once there is none
+void* operator new(size_t size) {
+    if (profiling) {
+        countAllocation(size);
+    }
+
+    void * p;
+
+    while ((p = malloc(size == 0 ? 1 : size)) == NULL) {
+        new_handler handler = get_new_handler();
+
+        if (handler == NULL) {
+            throw bad_alloc();
+        }
+
+        handler();
+    }
+
+    return p;
+}
+
+// Kept out of line, as once inlined where new was called GCC takes free for a mismatched deallocation
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+///////////////////////
+//  FASTA FUNCTIONS  //
+///////////////////////
+
+// Reader of the sequences of a FASTA file, one at a time
+struct FastaReader {
+    ifstream input;
+    string line;
+    bool has_line = false; // Whether the line was read ahead, ending the previous sequence
+};
+
+// Reads the next sequence of a FASTA file with one of the given names, returning false once there are none left
+//
+// EXTRA INFO:
+// - A sequence ends at the first line starting with ' ', '>' or ';' (a '>' line is kept, as it may name the next sequence)
+// - Only the first sequence of each name is read, as the name is removed once read
+//
+// INPUT:
+// - Reader of the file
+// - Names of the sequences to read
+// - Name of the sequence read
+// - Sequence read (or NULL to only find its length)
+// - Length of the sequence read
+bool nextRecord(FastaReader* reader, set<string>* names, string* name, string* contents, long int* length) {
+    PhaseScope scope(PHASE_READ);
+    bool found_seq = false;
+
+    *length = 0;
+
+    if (contents != NULL) {
+        contents->clear();
+    }
+
+    // Parse file line by line
+    while (reader->has_line or getline(reader->input, reader->line)) {
+        string& line = reader->line;
+        int line_length = line.length();
+
+        reader->has_line = false;
+
+        // Look for sequence name
+        if (found_seq == false) {
+            if (line_length > 0 && line[0] == '>') {
+                string line_name = "";
+                int i = 1;
+                while ( i < line_length && line[i] == ' ') {
+                    i++;
+                }
+                while ( i < line_length && line[i] != ' ' ) {
+                    line_name += line[i];
+                    i++;
+                }
+
+                // Sequence name found
+                if (names->count(line_name) > 0) {
+                    found_seq = true;
+                    *name = line_name;
+                    names->erase(line_name);
+                }
+            }
+        }
+        // Once sequence name is found, extract sequence
+        else {
+            if (line[0] != ' ' && line[0] != '>' && line[0] != ';') {
+                *length += line_length;
+
+                if (contents != NULL) {
+                    *contents += line;
+                }
+            }
+            else {
+                // End of sequence
+                reader->has_line = (line[0] == '>');
+                break;
+            }
+        }
+    }
+
+    return found_seq;
+}
+
+
+////////////////////////////////////////////////
+//  IUPAC CHARACTER MATRIX CLASS & FUNCTIONS  //
+////////////////////////////////////////////////
+
+// Inserts IUPAC characters mapping information into an STSL map
+void IUPAC_map_insert(I_map* IUPAC_map, int IUPAC_to_value[], char IUPAC_char, set<char> mapped_chars) {
+    static int index = 0;
+    IUPAC_map->insert( pair< char, set<char> > (IUPAC_char, mapped_chars) );
+    IUPAC_to_value[IUPAC_char] = index++;
+}
+
+// Set a value in a matrix stored as a 1D contiguous sequence of memory
+template<typename T>
+void set_value_for_matrix(T* mtx_ptr, uint32_t ncols, uint32_t i, uint32_t j, T val) {
+    mtx_ptr[i + i * (ncols - 1) + j] = val;
+}
+
+// Get a value from a matrix stored as a 1D contiguous sequence of memory
+template<typename T>
+T get_value_from_matrix(T* mtx, uint32_t ncols, uint32_t i, uint32_t j) {
+    return mtx[i + i * (ncols - 1) + j];
+}
+
+// Class to store preprocessed information relating to the match status of IUPAC characters
+class MatchMatrix {
+    public:
+        static bool* match_matrix;
+        static int IUPAC_map_count;
+        static int* IUPAC_to_value;
+        static int* IUPAC_to_mask;
+
+    static bool match(char a, char b) {
+        return get_value_from_matrix(match_matrix, IUPAC_map_count, IUPAC_to_value[a], IUPAC_to_value[b]);
+    }
+};
+
+bool* MatchMatrix::match_matrix;
+int MatchMatrix::IUPAC_map_count;
+int* MatchMatrix::IUPAC_to_value;
+int* MatchMatrix::IUPAC_to_mask;
+
+
+/////////////////////////////
+//  SEED FILTER FUNCTIONS  //
+/////////////////////////////
+
+// Longest seed whose 2-bit character codes fit in a 64-bit integer
+#define MAX_SEED_LEN 32
+
+// ENGINE_AUTO uses seeding when at most this fraction of centres is expected to be left to verify
+#define SEED_DENSITY_LIMIT 0.5
+
+// Multiplier used to hash seed codes (Fibonacci hashing)
+#define SEED_HASH_MULT 0x9E3779B97F4A7C15ULL
+
+// Returns the 2-bit code of a character ('u' is coded as 't'), or -1 if it is not one of 'a', 'c', 'g', 't', 'u'
+static __inline int seedCode(unsigned char ch) {
+    switch (ch) {
+        case 'a': return 0;
+        case 'c': return 1;
+        case 'g': return 2;
+        case 't': return 3;
+        case 'u': return 3;
+        default: return -1;
+    }
+}
+
+// Returns the seed length for given parameters
+//
+// EXTRA INFO:
+// - The first min_len characters of a palindrome arm hold at most 'mismatches' mismatches, so splitting them into
+//   mismatches + 1 blocks of this length leaves at least one block without mismatches (pigeonhole principle)
+static __inline int seedLength(int min_len, int mismatches) {
+    return min(min_len / (mismatches + 1), MAX_SEED_LEN);
+}
+
+// Returns the furthest offset from a centre (as used by the 'kangaroo method') at which a seed can start
+//
+// EXTRA INFO:
+// - Arms begin after a start mismatch within the initial gap, which is largest for even centres, and a seed lies within their first min_len characters
+static __inline int seedSpan(int min_len, int max_gap, int seed_len) {
+    int initial_gap = (max_gap % 2 == 1) ? (max_gap - 1) / 2 : max_gap / 2;
+
+    return initial_gap + min_len - seed_len;
+}
+
+// Estimates the fraction of centres left to verify after seeding
+//
+// EXTRA INFO:
+// - Assumes characters are independent with the base composition of the text, so a seed position matches with probability
+//   P^seed_len, where P is the probability that two characters are complementary, and seed matches are Poisson distributed
+// - Every centre close to a degenerate character is counted, as it is always verified
+//
+// INPUT:
+// - Text
+// - Text length
+// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap)
+double seedDensity(unsigned char* text, int n, tuple<int, int, int, int> params) {
+    int min_len = get<0>(params);
+    int mismatches = get<2>(params);
+    int max_gap = get<3>(params);
+
+    int seed_len = seedLength(min_len, mismatches);
+    int span = seedSpan(min_len, max_gap, seed_len);
+
+    long int counts[4] = {0, 0, 0, 0};
+    long int degenerate = 0;
+
+    for (int p = 0; p < n; p++) {
+        int code = seedCode(text[p]);
+
+        if (code == -1) {
+            degenerate++;
+        } else {
+            counts[code]++;
+        }
+    }
+
+    double P = 2.0 * (double(counts[0]) * counts[3] + double(counts[1]) * counts[2]) / (double(n) * n);
+    double seeded = 1.0 - exp(-(span + 1) * pow(P, seed_len));
+    double near_degenerate = double(degenerate) * (2 * (span + seed_len) + 1) / n;
+
+    return min(1.0, seeded + near_degenerate);
+}
+
+// Marks the centres that may hold a palindrome with given parameters
+//
+// EXTRA INFO:
+// - A centre is marked if the text and its reverse complement share a seed (exact k-mer) placed symmetrically around it,
+//   within reach of the initial gap, or if a degenerate character lies close enough to it to take part in a seed
+// - Seeds of the text are held in a hash table of positions, grouped by bucket and in increasing order, so that each seed of the
+//   reverse complement only visits the text positions within reach of it
+// - Marked centres are a superset of those holding a palindrome, which are then found by verifying only these centres
+//
+// INPUT:
+// - Bit vector of length 2n to mark centres c in, at index 2c
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Text length
+// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap)
+void seedCentres(bit_vector* centres, unsigned char* S, int n, tuple<int, int, int, int> params) {
+    int min_len = get<0>(params);
+    int mismatches = get<2>(params);
+    int max_gap = get<3>(params);
+
+    int seed_len = seedLength(min_len, mismatches);
+    int span = seedSpan(min_len, max_gap, seed_len);
+    uint64_t mask = (seed_len == MAX_SEED_LEN) ? ~0ULL : (1ULL << (2 * seed_len)) - 1;
+
+    // Mark centres close to degenerate characters
+    int reach = span + seed_len;
+    int marked_to = -1;
+
+    for (int d = 0; d < n; d++) {
+        if (seedCode(S[d]) != -1) {
+            continue;
+        }
+
+        for (int k = max(d - reach, marked_to + 1); k <= min(d + reach, n - 1); k++) {
+            (*centres)[2 * k] = 1;
+
+            if (k < n - 1) {
+                (*centres)[2 * k + 1] = 1;
+            }
+        }
+
+        marked_to = max(marked_to, min(d + reach, n - 1));
+    }
+
+    // Codes of seeds starting at each text position, and whether they contain only non-degenerate characters
+    int seeds_n = n - seed_len + 1;
+    vector<uint64_t> seed_codes(seeds_n);
+    bit_vector seed_valid(seeds_n, 0);
+
+    uint64_t code = 0;
+    int last_degenerate = -1;
+
+    for (int p = 0; p < n; p++) {
+        int ch = seedCode(S[p]);
+
+        if (ch == -1) {
+            last_degenerate = p;
+            ch = 0;
+        }
+
+        code = ((code << 2) | ch) & mask;
+
+        if (p >= seed_len - 1) {
+            seed_codes[p - seed_len + 1] = code;
+            seed_valid[p - seed_len + 1] = (last_degenerate <= p - seed_len);
+        }
+    }
+
+    // Build hash table of text seed positions
+    int bits = 1;
+    while (bits < 30 and (1 << bits) < seeds_n) {
+        bits++;
+    }
+
+    vector<int> bucket_start((1 << bits) + 1, 0);
+    vector<int> positions;
+
+    for (int p = 0; p < seeds_n; p++) {
+        if (seed_valid[p]) {
+            bucket_start[((seed_codes[p] * SEED_HASH_MULT) >> (64 - bits)) + 1]++;
+        }
+    }
+
+    for (int b = 0; b < (1 << bits); b++) {
+        bucket_start[b + 1] += bucket_start[b];
+    }
+
+    positions.resize(bucket_start[1 << bits]);
+    vector<int> bucket_fill(bucket_start.begin(), bucket_start.end() - 1);
+
+    for (int p = 0; p < seeds_n; p++) {
+        if (seed_valid[p]) {
+            positions[bucket_fill[(seed_codes[p] * SEED_HASH_MULT) >> (64 - bits)]++] = p;
+        }
+    }
+
+    // Look up seeds of the reverse complement, which follows the '$' in S
+    // The seed at u pairs text positions p + t with n - 1 - u - t, so a text seed at p > q = n - 1 - u is centred on c = (p + q) / 2,
+    // at offset ceil((p - q) / 2) - 1 from it
+    unsigned char* R = S + n + 1;
+    code = 0;
+    last_degenerate = -1;
+
+    for (int u = 0; u < n; u++) {
+        int ch = seedCode(R[u]);
+
+        if (ch == -1) {
+            last_degenerate = u;
+            ch = 0;
+        }
+
+        code = ((code << 2) | ch) & mask;
+
+        if (u < seed_len - 1 or last_degenerate > u - seed_len) {
+            continue;
+        }
+
+        int q = n - 1 - (u - seed_len + 1);
+        int p_max = min(q + 2 * span + 2, seeds_n - 1);
+
+        uint64_t bucket = (code * SEED_HASH_MULT) >> (64 - bits);
+        vector<int>::iterator it = lower_bound(positions.begin() + bucket_start[bucket], positions.begin() + bucket_start[bucket + 1], q + 1);
+        vector<int>::iterator bucket_end = positions.begin() + bucket_start[bucket + 1];
+
+        for (; it != bucket_end and *it <= p_max; ++it) {
+            if (seed_codes[*it] == code) {
+                (*centres)[*it + q] = 1;
+            }
+        }
+    }
+}
+
+
+//////////////////////////////
+//  RESULT STORE FUNCTIONS  //
+//////////////////////////////
+
+// Number of palindromes written to, and read back from, a run on disk at once
+#define RESULT_BATCH 65536
+
+// Palindromes held in sorted order while a search goes on, given out as soon as no centre left to scan can find any before them
+//
+// EXTRA INFO:
+// - Searches add palindromes with the range of centres they were found in; every palindrome found at centre c has left index at
+//   least c - reach, so once all centres before c are scanned, palindromes with left index below c - reach are final
+// - Final palindromes are given out sorted, without duplicates, in blocks of whole left index groups, while the search goes on;
+//   memory then holds only palindromes in the window of centres still being scanned, and the first output appears at once
+// - Palindromes not yet given out are gathered in memory into a run; a full run is sorted, stripped of duplicates and written to a
+//   file (removed at once, so its space is freed when it is closed) in a scratch directory, and merged back as it is given out
+// - Memory held is about one run, plus a buffer of RESULT_BATCH palindromes for each run written to a file; a search running ahead
+//   of the output waits for it to take the final palindromes once a run is full, so only palindromes not yet final are spilled
+// - A sequence may be searched in windows of centres one after another, each indexing only the text its palindromes may reach;
+//   palindromes are moved from indexes in that text to indexes in the whole sequence, and only those centred in the window kept
+// - A search resumed from a centre skips the centres before it, and drops palindromes starting before it (given out already)
+class ResultStore {
+    // Run written to a file, and the part of it read back while merging
+    struct Run {
+        FILE * file;
+        vector<int> buffer;
+        size_t next = 0;
+    };
+
+    mutex lock;
+    condition_variable changed;
+    string dir;
+    size_t run_limit = 0;
+    long int reach = 0;
+
+    // Palindromes held in memory: first those final (with left index below ready_limit), sorted, of which ready_next are given
+    // out, then from ready_end those not yet final, in the order they were added
+    vector< tuple<int, int, int> > run;
+    size_t ready_next = 0;
+    size_t ready_end = 0;
+    int ready_limit = INT_MIN;
+
+    // Runs written to files, with the next palindrome of each, smallest first
+    vector<Run> runs;
+    priority_queue< pair<tuple<int, int, int>, size_t>, vector< pair<tuple<int, int, int>, size_t> >, greater< pair<tuple<int, int, int>, size_t> > > heap;
+
+    // Centres scanned: all those before the frontier, and ranges beyond it (by first centre)
+    int frontier = 0;
+    map<int, int> scanned;
+    bool finished = false;
+
+    // Centre the search resumed from, with all palindromes starting before it given out by an earlier search
+    int resume_centre = 0;
+
+    // Window being searched: the centres window_from <= c < window_to of a text starting at text_offset, and whether the text
+    // holds other centres
+    long int text_offset = 0;
+    int window_from = 0;
+    int window_to = INT_MAX;
+    bool clipped = false;
+
+    // Sorts the palindromes held in memory that are not yet final and writes them to a file, exiting if the file cannot be written
+    void spill() {
+        sort(run.begin() + ready_end, run.end());
+        run.erase(unique(run.begin() + ready_end, run.end()), run.end());
+
+        string filename = dir + "/IUPACpal.XXXXXX";
+        vector<char> name(filename.begin(), filename.end());
+        name.push_back('\0');
+
+        int fd = mkstemp(name.data());
+        FILE * file = (fd == -1) ? NULL : fdopen(fd, "w+b");
+
+        if (file == NULL) {
+            fprintf(stderr, " Error: Cannot write results in '%s'.\n", dir.c_str() );
+            exit(EXIT_FAILURE);
+        }
+
+        unlink(name.data());
+
+        vector<int> buffer;
+        buffer.reserve(3 * RESULT_BATCH);
+
+        for (size_t from = ready_end; from < run.size(); from += RESULT_BATCH) {
+            buffer.clear();
+
+            for (size_t i = from; i < min(from + RESULT_BATCH, run.size()); i++) {
+                buffer.push_back(get<0>(run[i]));
+                buffer.push_back(get<1>(run[i]));
+                buffer.push_back(get<2>(run[i]));
+            }
+
+            if (fwrite(buffer.data(), sizeof(int), buffer.size(), file) != buffer.size()) {
+                fprintf(stderr, " Error: Cannot write results in '%s'.\n", dir.c_str() );
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        rewind(file);
+
+        Run spilled;
+        spilled.file = file;
+        runs.push_back(spilled);
+
+        tuple<int, int, int> palindrome;
+
+        if (advance(runs.size() - 1, &palindrome)) {
+            heap.push(make_pair(palindrome, runs.size() - 1));
+        }
+
+        run.resize(ready_end);
+        run.shrink_to_fit();
+    }
+
+    // Gives the next palindrome of a run written to a file, returning false once the run is used up
+    bool advance(size_t source, tuple<int, int, int>* palindrome) {
+        Run& spilled = runs[source];
+
+        if (spilled.next == spilled.buffer.size()) {
+            spilled.buffer.resize(3 * RESULT_BATCH);
+            spilled.buffer.resize(fread(spilled.buffer.data(), sizeof(int), spilled.buffer.size(), spilled.file));
+            spilled.next = 0;
+
+            if (spilled.buffer.empty()) {
+                return false;
+            }
+        }
+
+        *palindrome = tuple<int, int, int>(spilled.buffer[spilled.next], spilled.buffer[spilled.next + 1], spilled.buffer[spilled.next + 2]);
+        spilled.next += 3;
+
+        return true;
+    }
+
+    // Drops the final palindromes given out, and sorts to the front those held in memory with left index below a new limit
+    void makeReady(int limit) {
+        run.erase(run.begin(), run.begin() + ready_end);
+
+        vector< tuple<int, int, int> >::iterator below = partition(run.begin(), run.end(), [&](const tuple<int, int, int>& palindrome) {
+            return get<0>(palindrome) < limit;
+        });
+
+        sort(run.begin(), below);
+        below = run.erase(unique(run.begin(), below), below);
+
+        ready_next = 0;
+        ready_end = below - run.begin();
+        ready_limit = limit;
+    }
+
+public:
+    // Sets where runs are written, how large they may grow, and how far before their centre palindromes may start
+    //
+    // INPUT:
+    // - Directory to write runs to
+    // - Memory for the run held in memory, in bytes (0 for no limit)
+    // - Largest distance from a centre to the left index of a palindrome found there
+    // - First centre to be scanned
+    void open(string scratch_dir, long int memory, long int palindrome_reach, int first_centre) {
+        dir = scratch_dir;
+        run_limit = memory / sizeof(tuple<int, int, int>);
+        reach = palindrome_reach;
+        frontier = first_centre;
+    }
+
+    // Sets the window searched next, whose palindromes are added with indexes in its text
+    //
+    // INPUT:
+    // - Index of the text in the whole sequence
+    // - Length of the text
+    // - First centre of the window (in the whole sequence)
+    // - Centre after the last of the window
+    void window(long int offset, long int n, int from, int to) {
+        lock_guard<mutex> guard(lock);
+        text_offset = offset;
+        window_from = from;
+        window_to = to;
+        clipped = (from > offset or to < offset + n);
+    }
+
+    // Resumes a search from a centre, as if all centres before it were scanned and all palindromes starting before it given out
+    void resume(int centre) {
+        lock_guard<mutex> guard(lock);
+        resume_centre = centre;
+        frontier = max(frontier, centre);
+        ready_limit = max(ready_limit, centre);
+    }
+
+    // Narrows a range of centres of the text of the window to those to be scanned
+    void centres(int* k_from, int* k_to) {
+        lock_guard<mutex> guard(lock);
+        *k_from = max((long int) *k_from, max(window_from, resume_centre) - text_offset);
+        *k_to = max((long int) *k_from, min((long int) *k_to, window_to - text_offset));
+    }
+
+    // Moves the palindromes of a buffer to the store, from any thread, marking the centres k_from <= k < k_to as scanned (all
+    // with indexes in the text of the window)
+    void add(vector< tuple<int, int, int> >* palindromes, int k_from, int k_to) {
+        unique_lock<mutex> guard(lock);
+
+        if (text_offset > 0 or clipped or resume_centre > 0) {
+            for (tuple<int, int, int>& palindrome : *palindromes) {
+                get<0>(palindrome) += text_offset;
+                get<1>(palindrome) += text_offset;
+            }
+
+            // A palindrome (left, right) found at centre c has (left + right) / 2 = c
+            palindromes->erase(remove_if(palindromes->begin(), palindromes->end(), [&](const tuple<int, int, int>& palindrome) {
+                int centre = ((long int) get<0>(palindrome) + get<1>(palindrome)) / 2;
+                return centre < window_from or centre >= window_to or get<0>(palindrome) < resume_centre;
+            }), palindromes->end());
+
+            k_from += text_offset;
+            k_to += text_offset;
+        }
+
+        if (run.empty() and (run_limit == 0 or palindromes->size() >= run_limit)) {
+            run.swap(*palindromes);
+        } else {
+            // A run is given room for its limit at once, rather than doubling past it, after dropping the palindromes given out
+            if (run_limit > 0 and run.size() + palindromes->size() > run.capacity()) {
+                run.erase(run.begin(), run.begin() + ready_next);
+                ready_end -= ready_next;
+                ready_next = 0;
+
+                if (run.size() + palindromes->size() > run.capacity()) {
+                    run.reserve(max(run_limit, run.size() + palindromes->size()));
+                }
+            }
+
+            run.insert(run.end(), palindromes->begin(), palindromes->end());
+        }
+
+        vector< tuple<int, int, int> >().swap(*palindromes);
+
+        if (k_from < k_to) {
+            scanned[k_from] = k_to;
+
+            while (!scanned.empty() and scanned.begin()->first <= frontier) {
+                frontier = max(frontier, scanned.begin()->second);
+                scanned.erase(scanned.begin());
+            }
+
+            changed.notify_all();
+        }
+
+        // A search running ahead of the output waits for it to take the final palindromes, rather than writing them to files
+        while (run_limit > 0 and run.size() - ready_next >= run_limit and (ready_next < ready_end or ready_limit < frontier - reach)) {
+            changed.notify_all();
+            changed.wait(guard);
+        }
+
+        if (run_limit > 0 and run.size() - ready_end >= run_limit) {
+            spill();
+        }
+    }
+
+    // Marks that all palindromes are added
+    void finish() {
+        lock_guard<mutex> guard(lock);
+        finished = true;
+        changed.notify_all();
+    }
+
+    // Returns the number of runs written to files
+    size_t spilled() {
+        lock_guard<mutex> guard(lock);
+        return runs.size();
+    }
+
+    // Gives the next final palindromes in sorted order as a block of whole left index groups, waiting until there are some or
+    // more centres are scanned (giving an empty block), and returning false once all are given
+    //
+    // INPUT:
+    // - Buffer for the block
+    // - Number of palindromes after which the block ends with the current left index group
+    // - Left index below which all palindromes are given out, once the block is
+    bool next(vector< tuple<int, int, int> >* block, size_t size, int* given) {
+        unique_lock<mutex> guard(lock);
+        block->clear();
+        bool advanced = false;
+
+        // Searches waiting for palindromes to be taken may go on
+        changed.notify_all();
+
+        while (true) {
+            bool in_ready = (ready_next < ready_end);
+            bool in_heap = (!heap.empty() and get<0>(heap.top().first) < ready_limit);
+
+            if (in_ready or in_heap) {
+                // Take the smaller of the next final palindromes in memory and in the runs written to files
+                tuple<int, int, int> palindrome;
+
+                if (in_ready and (!in_heap or run[ready_next] <= heap.top().first)) {
+                    palindrome = run[ready_next];
+
+                    if (block->size() >= size and get<0>(palindrome) != get<0>(block->back())) {
+                        *given = get<0>(palindrome);
+                        break;
+                    }
+
+                    ready_next++;
+                } else {
+                    palindrome = heap.top().first;
+                    size_t source = heap.top().second;
+
+                    if (block->size() >= size and get<0>(palindrome) != get<0>(block->back())) {
+                        *given = get<0>(palindrome);
+                        break;
+                    }
+
+                    heap.pop();
+
+                    tuple<int, int, int> following;
+
+                    if (advance(source, &following)) {
+                        heap.push(make_pair(following, source));
+                    }
+                }
+
+                // Duplicates found in different runs are next to each other once merged
+                if (block->empty() or palindrome != block->back()) {
+                    block->push_back(palindrome);
+                }
+
+                continue;
+            }
+
+            // All palindromes left start at or after the limit
+            if (!block->empty() or advanced) {
+                *given = ready_limit;
+                break;
+            }
+
+            // Once all palindromes are added every one is final, otherwise those before the window of centres still being scanned
+            int limit = finished ? INT_MAX : (int) max((long int) INT_MIN, frontier - reach);
+
+            if (limit > ready_limit) {
+                makeReady(limit);
+                advanced = true;
+                continue;
+            }
+
+            if (finished) {
+                return false;
+            }
+
+            changed.wait(guard);
+        }
+
+        return true;
+    }
+
+    // Closes the files of all runs and releases all palindromes
+    void close() {
+        lock_guard<mutex> guard(lock);
+
+        for (Run& spilled : runs) {
+            fclose(spilled.file);
+        }
+
+        runs.clear();
+        heap = decltype(heap)();
+        vector< tuple<int, int, int> >().swap(run);
+        ready_next = 0;
+        ready_end = 0;
+    }
+};
+
+
+/////////////////////////////////////
+//  PARALLEL SCHEDULING FUNCTIONS  //
+/////////////////////////////////////
+
+// Smallest number of centres handed out at once
+#define SCHEDULER_MIN_CHUNK 64
+
+// Chunks finishing faster than this (in seconds) are doubled in size, and slower ones halved
+#define SCHEDULER_CHUNK_TIME 0.002
+
+// Range of centres still to be scanned by one thread, which other threads may steal from the back of
+struct CentreShare {
+    mutex lock;
+    int begin, end;
+};
+
+// Scans centres k_from <= k < k_to on a number of threads with work stealing, adding all palindromes found to an output buffer
+//
+// EXTRA INFO:
+// - Each thread starts with an equal share of the centres and takes chunks from the front of it; once its share runs out, it steals
+//   the back half of the largest share left, so threads stuck in slow regions (such as runs of 'n') are relieved by the others
+// - Chunk sizes adapt to how long chunks take, so slow regions are split finely while fast ones cost little scheduling
+// - Each thread adds palindromes to its own buffer, appended to the output buffer in thread order once all are done; palindromes are
+//   sorted before printing, so the output does not depend on which thread scanned which centres
+// - If the output buffer passes palindromes on to a result store, each thread's buffer is moved to the store after every chunk,
+//   with the range of centres scanned, so the store can give out palindromes before all centres are scanned
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - First centre to scan
+// - Centre after the last to scan
+// - Number of threads
+// - Function scanning centres k_from <= k < k_to (odd and even) into a given buffer
+void scanCentres(P_buffer* palindromes, int k_from, int k_to, int threads, function<void(P_buffer*, int, int)> scan) {
+    // Only the centres of the window searched are scanned, from the one a search resumed from
+    if (palindromes->store != NULL) {
+        palindromes->store->centres(&k_from, &k_to);
+    }
+
+    if (threads <= 1 and palindromes->store == NULL) {
+        TraceScope span("centres", "chunk", "from", k_from, "to", k_to);
+        scan(palindromes, k_from, k_to);
+        return;
+    }
+
+    vector<CentreShare> shares(threads);
+    vector<P_buffer> buffers(threads);
+
+    for (int t = 0; t < threads; t++) {
+        shares[t].begin = k_from + (long int) (k_to - k_from) * t / threads;
+        shares[t].end = k_from + (long int) (k_to - k_from) * (t + 1) / threads;
+    }
+
+    // Workers count in the phase of the thread scanning
+    int phase = currentPhase();
+
+    auto worker = [&](int t) {
+        int chunk = SCHEDULER_MIN_CHUNK;
+        traceThread("scan");
+        WorkerPhase worker_phase(phase);
+
+        while (true) {
+            int k_from = 0, k_to = 0;
+
+            // Take the next chunk of this thread's share
+            shares[t].lock.lock();
+            if (shares[t].begin < shares[t].end) {
+                k_from = shares[t].begin;
+                k_to = min(shares[t].end, k_from + chunk);
+                shares[t].begin = k_to;
+            }
+            shares[t].lock.unlock();
+
+            // Otherwise steal the back half of the largest share left
+            if (k_from == k_to) {
+                int victim = -1, most = 0;
+
+                for (int v = 0; v < threads; v++) {
+                    shares[v].lock.lock();
+                    if (v != t and shares[v].end - shares[v].begin > most) {
+                        victim = v;
+                        most = shares[v].end - shares[v].begin;
+                    }
+                    shares[v].lock.unlock();
+                }
+
+                if (victim == -1) {
+                    break;
+                }
+
+                int stolen_from = 0, stolen_to = 0;
+
+                shares[victim].lock.lock();
+                if (shares[victim].begin < shares[victim].end) {
+                    stolen_from = shares[victim].begin + (shares[victim].end - shares[victim].begin) / 2;
+                    stolen_to = shares[victim].end;
+                    shares[victim].end = stolen_from;
+                }
+                shares[victim].lock.unlock();
+
+                shares[t].lock.lock();
+                shares[t].begin = stolen_from;
+                shares[t].end = stolen_to;
+                shares[t].lock.unlock();
+
+                continue;
+            }
+
+            TraceScope span("centres", "chunk", "from", k_from, "to", k_to);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            scan(&buffers[t], k_from, k_to);
+            double taken = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            span.end();
+
+            // Handing over may wait for the store to spill, which shows in the trace
+            if (palindromes->store != NULL) {
+                TraceScope store_span("store", "chunk", "from", k_from, "to", k_to);
+                palindromes->store->add(&buffers[t], k_from, k_to);
+            }
+
+            if (taken < SCHEDULER_CHUNK_TIME and chunk < INT_MAX / 2) {
+                chunk *= 2;
+            } else if (taken > SCHEDULER_CHUNK_TIME and chunk > SCHEDULER_MIN_CHUNK) {
+                chunk /= 2;
+            }
+        }
+    };
+
+    vector<thread> pool;
+
+    for (int t = 0; t < threads; t++) {
+        pool.push_back(thread(worker, t));
+    }
+
+    size_t total = palindromes->size();
+
+    for (int t = 0; t < threads; t++) {
+        pool[t].join();
+        total += buffers[t].size();
+    }
+
+    palindromes->reserve(total);
+
+    for (int t = 0; t < threads; t++) {
+        palindromes->insert(palindromes->end(), buffers[t].begin(), buffers[t].end());
+        P_buffer().swap(buffers[t]);
+    }
+}
+
+// Queue handing items from one thread to another, holding at most a given number of items
+//
+// EXTRA INFO:
+// - With capacity 0 an item is handed over directly, so adding it waits until it has been taken
+template <class T>
+class Pipe {
+    mutex lock;
+    condition_variable changed;
+    list<T> items;
+    size_t capacity;
+    long int added = 0;
+    long int taken = 0;
+    bool closed = false;
+
+public:
+    Pipe(size_t capacity) : capacity(capacity) {}
+
+    // Adds an item, waiting while the pipe is full
+    void push(T item) {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&]() { return items.size() < max(capacity, (size_t) 1); });
+
+        items.push_back(item);
+        long int ticket = ++added;
+        changed.notify_all();
+
+        if (capacity == 0) {
+            changed.wait(guard, [&]() { return taken >= ticket; });
+        }
+    }
+
+    // Takes the oldest item, waiting while the pipe is empty, and returns false once it is empty and closed
+    bool pop(T* item) {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&]() { return !items.empty() or closed; });
+
+        if (items.empty()) {
+            return false;
+        }
+
+        *item = items.front();
+        items.pop_front();
+        taken++;
+        changed.notify_all();
+
+        return true;
+    }
+
+    // Marks that no more items will be added
+    void close() {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        changed.notify_all();
+    }
+};
+
+
+///////////////////////////////////////
+//  EXTERNAL MEMORY INDEX FUNCTIONS  //
+///////////////////////////////////////
+
+// Returns the number of bytes taken by the index (SA, invSA, LCP and RMQ data) of a text of given length when built in memory
+//
+// INPUT:
+// - Text length
+long int indexMemory(INT S_n) {
+    long int bytes = 3 * S_n * sizeof(INT);
+
+    #ifdef _USE_NLOGN_RMQ
+        bytes += S_n * flog2(S_n) * sizeof(INT);
+    #else
+        bytes += S_n * sizeof(uint64_t);
+    #endif
+
+    return bytes;
+}
+
+// Creates a temporary file holding an array of INTs and maps it into memory, returning NULL on failure
+//
+// EXTRA INFO:
+// - The file is removed at once, so its space is freed when the array is unmapped (or the program exits)
+// - Pages of the array are written back to the file, rather than held in memory, whenever memory runs short
+//
+// INPUT:
+// - Directory to create the file in
+// - Array length
+INT * mapArray(string dir, INT length) {
+    string filename = dir + "/IUPACpal.XXXXXX";
+    vector<char> name(filename.begin(), filename.end());
+    name.push_back('\0');
+
+    int fd = mkstemp(name.data());
+
+    if (fd == -1) {
+        return NULL;
+    }
+
+    unlink(name.data());
+
+    void * array = MAP_FAILED;
+
+    if (ftruncate(fd, length * sizeof(INT)) == 0) {
+        array = mmap(NULL, length * sizeof(INT), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+
+    return (array == MAP_FAILED) ? NULL : (INT *) array;
+}
+
+// Unmaps an array created by mapArray
+//
+// INPUT:
+// - Array
+// - Array length
+void unmapArray(INT * array, INT length) {
+    munmap(array, length * sizeof(INT));
+}
+
+// Writes a text to the file sdsl expects for it under a cache configuration, followed by the 0 that sdsl appends to texts
+//
+// INPUT:
+// - Text (holding no 0)
+// - Text length
+// - sdsl cache configuration (giving the directory to write to)
+void cacheText(unsigned char* S, INT S_n, cache_config& config) {
+    {
+        int_vector_buffer<8> text_buf(cache_file_name(conf::KEY_TEXT, config), std::ios::out);
+
+        for (INT i = 0; i < S_n; i++) {
+            text_buf.push_back(S[i]);
+        }
+
+        text_buf.push_back(0);
+    }
+
+    register_cache_file(conf::KEY_TEXT, config);
+}
+
+// Builds the inverse suffix array, LCP array and RMQ data of a text in bounded memory, using files in a scratch directory
+//
+// EXTRA INFO:
+// - The suffix array and LCP array are built semi-externally by sdsl, holding only the text and small buffers in memory
+// - invSA (with LCP and 'A' for Type 1 RMQs) are arrays mapped from files, so the search runs over them as over arrays in memory
+// - For Type 2 RMQs, LCP is held in memory, bit-compressed to the width of its largest value
+// - sdsl appends a 0 to the text, sorted before every suffix, so its suffix and LCP arrays are those of S shifted by one rank
+//
+// INPUT:
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Scratch directory
+// - Inverse Suffix Array, Longest Common Prefix Array and RMQ data to fill (Type 1: 'A', Type 2: 'rmq')
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+bool buildIndexExternal(unsigned char* S, INT S_n, string scratch_dir, INT ** invSA, INT ** LCP, INT ** A) {
+#else
+// Using Type 2 RMQs
+bool buildIndexExternal(unsigned char* S, INT S_n, string scratch_dir, INT ** invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq) {
+#endif
+    cache_config config(false, scratch_dir);
+    bool built = false;
+
+    cacheText(S, S_n, config);
+    construct_sa_se(config);
+    construct_lcp_semi_extern_PHI(config);
+
+    *invSA = mapArray(scratch_dir, S_n);
+
+    #ifdef _USE_NLOGN_RMQ
+        *LCP = mapArray(scratch_dir, S_n);
+        bool allocated = (*invSA != NULL and *LCP != NULL);
+    #else
+        bool allocated = (*invSA != NULL);
+    #endif
+
+    if (allocated) {
+        int_vector_buffer<> sa_buf(cache_file_name(conf::KEY_SA, config));
+        int_vector_buffer<> lcp_buf(cache_file_name(conf::KEY_LCP, config));
+
+        #ifndef _USE_NLOGN_RMQ
+            LCP = int_vector<>(S_n, 0, lcp_buf.width());
+        #endif
+
+        for (INT i = 0; i < S_n; i++) {
+            (*invSA)[sa_buf[i + 1]] = i;
+
+            #ifdef _USE_NLOGN_RMQ
+                (*LCP)[i] = lcp_buf[i + 1];
+            #else
+                LCP[i] = lcp_buf[i + 1];
+            #endif
+        }
+
+        #ifndef _USE_NLOGN_RMQ
+            util::bit_compress(LCP);
+        #endif
+
+        built = true;
+    }
+
+    util::delete_all_files(config.file_map);
+
+    if (!built) {
+        return false;
+    }
+
+    #ifdef _USE_NLOGN_RMQ
+        *A = mapArray(scratch_dir, S_n * flog2(S_n));
+
+        if (*A == NULL) {
+            return false;
+        }
+
+        rmq_preprocess(*A, *LCP, S_n);
+    #else
+        rmq = rmq_succinct_sct<>(&LCP);
+    #endif
+
+    return true;
+}
+
+
+////////////////////////////
+//  INDEX ARENA FUNCTIONS  //
+////////////////////////////
+
+// Size of a huge page, to which the arena and the arrays within it are aligned
+#define ARENA_PAGE (2 * 1024 * 1024)
+
+// A single mapping holding the index arrays built in memory, so they are allocated (and released) together
+struct IndexArena {
+    char * mapping = NULL;
+    size_t mapping_size = 0;
+    char * base = NULL;
+    size_t size = 0;
+    size_t used = 0;
+    bool hugetlb = false; // Backed by reserved huge pages, rather than transparent ones
+};
+
+// Maps an arena of at least the given number of bytes, returning whether it succeeded
+//
+// EXTRA INFO:
+// - With huge pages, reserved huge pages (MAP_HUGETLB) are tried first, then transparent huge pages are requested
+// - Arrays read at random (as invSA, LCP and 'A' are by the search) then take far fewer TLB entries
+//
+// INPUT:
+// - Arena to map
+// - Number of bytes
+// - Whether to back the arena by huge pages
+bool openArena(IndexArena * arena, size_t bytes, bool hugepages) {
+    arena->size = ((bytes + ARENA_PAGE - 1) / ARENA_PAGE) * ARENA_PAGE;
+    arena->used = 0;
+    arena->hugetlb = false;
+
+    void * mapping = MAP_FAILED;
+
+    if (hugepages) {
+        mapping = mmap(NULL, arena->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        arena->hugetlb = (mapping != MAP_FAILED);
+    }
+
+    if (arena->hugetlb) {
+        arena->mapping_size = arena->size;
+        arena->mapping = (char *) mapping;
+        arena->base = (char *) mapping;
+        return true;
+    }
+
+    // Transparent huge pages need an aligned range, so one extra page is mapped to align the arena within it
+    arena->mapping_size = arena->size + ARENA_PAGE;
+    mapping = mmap(NULL, arena->mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    arena->mapping = (char *) mapping;
+    arena->base = (char *) ((((uintptr_t) mapping + ARENA_PAGE - 1) / ARENA_PAGE) * ARENA_PAGE);
+
+    #ifdef MADV_HUGEPAGE
+        if (hugepages) {
+            madvise(arena->base, arena->size, MADV_HUGEPAGE);
+        }
+    #endif
+
+    return true;
+}
+
+// Returns an array of INTs taken from an arena, or NULL if the arena is full
+//
+// INPUT:
+// - Arena
+// - Array length
+INT * arenaArray(IndexArena * arena, INT length) {
+    size_t bytes = ((length * sizeof(INT) + ARENA_PAGE - 1) / ARENA_PAGE) * ARENA_PAGE;
+
+    if (arena->used + bytes > arena->size) {
+        return NULL;
+    }
+
+    INT * array = (INT *) (arena->base + arena->used);
+    arena->used += bytes;
+
+    return array;
+}
+
+// Unmaps an arena, releasing every array taken from it
+//
+// INPUT:
+// - Arena
+void closeArena(IndexArena * arena) {
+    if (arena->mapping != NULL) {
+        munmap(arena->mapping, arena->mapping_size);
+    }
+
+    arena->mapping = NULL;
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+// Returns the number of bytes of an arena holding the index arrays built in memory for a text of given length
+//
+// EXTRA INFO:
+// - Holds SA and invSA, with LCP and 'A' for Type 1 RMQs (Type 2 RMQ data is held by sdsl)
+// - Each array starts on its own huge page
+//
+// INPUT:
+// - Text length
+size_t arenaMemory(INT S_n) {
+    size_t array_bytes = ((S_n * sizeof(INT) + ARENA_PAGE - 1) / ARENA_PAGE) * ARENA_PAGE;
+    size_t bytes = 2 * array_bytes;
+
+    #ifdef _USE_NLOGN_RMQ
+        bytes += array_bytes;
+        bytes += ((S_n * flog2(S_n) * sizeof(INT) + ARENA_PAGE - 1) / ARENA_PAGE) * ARENA_PAGE;
+    #endif
+
+    return bytes;
+}
+
+// Most arenas mapped at once by a pool, as the pipeline holds at most two indexes (one searched while the next is built)
+#define ARENA_POOL 2
+
+// Arenas kept mapped between the records of a run, so that the index of each record reuses pages already faulted in
+struct ArenaPool {
+    mutex lock;
+    vector<IndexArena> idle;
+    int mapped = 0; // Arenas mapped, whether idle or held by a record
+};
+
+// Takes an arena of at least the given number of bytes from a pool, mapping one if none is large enough, and returns whether it
+// succeeded
+//
+// EXTRA INFO:
+// - Takes the smallest idle arena large enough; otherwise one idle arena is unmapped first, so the pool never maps more than
+//   ARENA_POOL arenas while records hold at most that many
+// - A reused arena keeps the backing (huge pages or not) it was mapped with, as all arenas of a run are mapped alike
+//
+// INPUT:
+// - Pool
+// - Arena taken
+// - Number of bytes
+// - Whether to back the arena by huge pages
+bool takeArena(ArenaPool * pool, IndexArena * arena, size_t bytes, bool hugepages) {
+    lock_guard<mutex> guard(pool->lock);
+    int best = -1;
+
+    for (size_t i = 0; i < pool->idle.size(); i++) {
+        if (pool->idle[i].size >= bytes and (best == -1 or pool->idle[i].size < pool->idle[best].size)) {
+            best = i;
+        }
+    }
+
+    if (best != -1) {
+        *arena = pool->idle[best];
+        arena->used = 0;
+        pool->idle.erase(pool->idle.begin() + best);
+        return true;
+    }
+
+    if (!pool->idle.empty() and pool->mapped >= ARENA_POOL) {
+        closeArena(&pool->idle.back());
+        pool->idle.pop_back();
+        pool->mapped--;
+    }
+
+    if (!openArena(arena, bytes, hugepages)) {
+        return false;
+    }
+
+    pool->mapped++;
+    return true;
+}
+
+// Gives an arena back to a pool once its index is no longer needed, unmapping it if the pool maps more than it keeps
+//
+// INPUT:
+// - Pool
+// - Arena given back (left empty)
+void returnArena(ArenaPool * pool, IndexArena * arena) {
+    lock_guard<mutex> guard(pool->lock);
+
+    if (arena->mapping == NULL) {
+        return;
+    }
+
+    if (pool->mapped > ARENA_POOL) {
+        closeArena(arena);
+        pool->mapped--;
+    } else {
+        pool->idle.push_back(*arena);
+    }
+
+    *arena = IndexArena();
+}
+
+// Unmaps the idle arenas of a pool
+//
+// INPUT:
+// - Pool
+void closeArenaPool(ArenaPool * pool) {
+    lock_guard<mutex> guard(pool->lock);
+
+    for (IndexArena& arena : pool->idle) {
+        closeArena(&arena);
+        pool->mapped--;
+    }
+
+    pool->idle.clear();
+}
+
+
+/////////////////////
+//  NUMA FUNCTIONS  //
+/////////////////////
+
+// Memory policies of set_mempolicy (as in numaif.h, which needs libnuma)
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT 0
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+// Largest number of NUMA nodes handled
+#define NUMA_MAX_NODES 1024
+
+// A NUMA node and the CPUs it holds
+struct NumaNode {
+    int id;
+    vector<int> cpus;
+};
+
+// Returns the NUMA nodes holding CPUs, as listed in sysfs (a single node holding no listed CPUs if sysfs gives none)
+vector<NumaNode> numaNodes() {
+    vector<NumaNode> nodes;
+
+    for (int id = 0; id < NUMA_MAX_NODES; id++) {
+        string dir = "/sys/devices/system/node/node" + to_string(id);
+
+        if (!exist(dir.c_str())) {
+            continue;
+        }
+
+        NumaNode node;
+        node.id = id;
+
+        // CPU lists are comma separated ranges, such as "0-3,8-11"
+        ifstream cpulist(dir + "/cpulist");
+        string range;
+
+        while (getline(cpulist, range, ',')) {
+            int first, last;
+            int read = sscanf(range.c_str(), "%d-%d", &first, &last);
+
+            if (read == 1) {
+                last = first;
+            }
+
+            for (int cpu = first; read >= 1 and cpu <= last; cpu++) {
+                node.cpus.push_back(cpu);
+            }
+        }
+
+        if (!node.cpus.empty()) {
+            nodes.push_back(node);
+        }
+    }
+
+    if (nodes.empty()) {
+        nodes.push_back(NumaNode{0, vector<int>()});
+    }
+
+    return nodes;
+}
+
+// Restricts the calling thread (and threads it starts) to the CPUs of a NUMA node, returning whether it succeeded
+//
+// EXTRA INFO:
+// - Memory first touched by the thread is then placed on that node
+//
+// INPUT:
+// - NUMA node
+bool pinToNode(const NumaNode& node) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    for (int cpu : node.cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+
+    return (CPU_COUNT(&cpus) > 0 and sched_setaffinity(0, sizeof(cpus), &cpus) == 0);
+}
+
+// Sets the memory of the calling thread to be interleaved page by page over NUMA nodes, or placed as usual if given none
+//
+// INPUT:
+// - NUMA nodes to interleave over
+void interleaveMemory(const vector<NumaNode>& nodes) {
+    unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+
+    for (const NumaNode& node : nodes) {
+        mask[node.id / (8 * sizeof(unsigned long))] |= 1UL << (node.id % (8 * sizeof(unsigned long)));
+    }
+
+    if (nodes.empty()) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+    } else {
+        syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask, NUMA_MAX_NODES + 1);
+    }
+}
+
+// Copy of the read-only index arrays, placed on the NUMA node of the thread making it
+struct IndexReplica {
+    IndexArena arena;
+    INT * invSA;
+
+    #ifdef _USE_NLOGN_RMQ
+        INT * LCP;
+        INT * A;
+    #else
+        int_vector<> LCP;
+        rmq_succinct_sct<> rmq;
+    #endif
+};
+
+// Copies the index arrays searched into a replica, returning whether it succeeded
+//
+// INPUT:
+// - Replica to fill
+// - Length of S
+// - Inverse Suffix Array
+// - Longest Common Prefix Array (LCP)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+// - Whether to back the replica by huge pages
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+bool replicateIndex(IndexReplica * replica, INT S_n, INT * invSA, INT * LCP, INT * A, bool hugepages) {
+#else
+// Using Type 2 RMQs
+bool replicateIndex(IndexReplica * replica, INT S_n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq, bool hugepages) {
+#endif
+    if (!openArena(&replica->arena, arenaMemory(S_n), hugepages)) {
+        return false;
+    }
+
+    // The arena holds room for SA, not needed by the search
+    arenaArray(&replica->arena, S_n);
+    replica->invSA = arenaArray(&replica->arena, S_n);
+    memcpy(replica->invSA, invSA, S_n * sizeof(INT));
+
+    #ifdef _USE_NLOGN_RMQ
+        replica->LCP = arenaArray(&replica->arena, S_n);
+        replica->A = arenaArray(&replica->arena, S_n * flog2(S_n));
+        memcpy(replica->LCP, LCP, S_n * sizeof(INT));
+        memcpy(replica->A, A, S_n * flog2(S_n) * sizeof(INT));
+    #else
+        replica->LCP = LCP;
+        replica->rmq = rmq;
+    #endif
+
+    return true;
+}
+
+
+////////////////////////////
+//  INDEX FILE FUNCTIONS  //
+////////////////////////////
+
+// Writes an array to a file in the layout of a serialized sdsl int_vector of fixed width, returning whether it succeeded
+//
+// EXTRA INFO:
+// - The layout is a 64-bit size (in bits) followed by the values, padded to a whole number of 64-bit words, so files can be read
+//   with sdsl (load_from_file, int_vector_mapper) as well as mapped directly
+//
+// INPUT:
+// - Filename
+// - Array
+// - Array length
+// - Width of each value in bits (8, 16, 32 or 64)
+bool storeVector(string filename, const void * data, uint64_t length, int width) {
+    FILE * f = fopen(filename.c_str(), "wb");
+
+    if (f == NULL) {
+        return false;
+    }
+
+    uint64_t bits = length * width;
+    uint64_t padding = ((bits + 63) / 64) * 8 - bits / 8;
+    uint64_t zero = 0;
+
+    bool written = fwrite(&bits, sizeof(uint64_t), 1, f) == 1
+                   and fwrite(data, width / 8, length, f) == length
+                   and fwrite(&zero, 1, padding, f) == padding;
+
+    return (fclose(f) == 0) and written;
+}
+
+// Returns the number of bytes taken by a file written by storeVector
+//
+// INPUT:
+// - Array length
+// - Width of each value in bits
+uint64_t vectorFileSize(uint64_t length, int width) {
+    return sizeof(uint64_t) + ((length * width + 63) / 64) * 8;
+}
+
+// Maps a file written by storeVector into memory read-only, returning its values, or NULL if it is missing or of another length
+//
+// EXTRA INFO:
+// - The mapping is shared, so processes mapping the same file use one copy of it in the page cache
+// - Pages are read in at once (MAP_POPULATE), and marked as randomly accessed so that no time is spent reading ahead
+//
+// INPUT:
+// - Filename
+// - Array length
+// - Width of each value in bits
+void * mapVector(string filename, uint64_t length, int width) {
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat file_stat;
+    uint64_t bytes = vectorFileSize(length, width);
+    uint64_t bits = 0;
+    void * base = MAP_FAILED;
+
+    if (fstat(fd, &file_stat) == 0 and (uint64_t) file_stat.st_size == bytes and read(fd, &bits, sizeof(uint64_t)) == sizeof(uint64_t)
+        and bits == length * width) {
+        base = mmap(NULL, bytes, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    madvise(base, bytes, MADV_RANDOM);
+
+    return (char *) base + sizeof(uint64_t);
+}
+
+// Unmaps values returned by mapVector
+//
+// INPUT:
+// - Values
+// - Array length
+// - Width of each value in bits
+void unmapVector(void * data, uint64_t length, int width) {
+    munmap((char *) data - sizeof(uint64_t), vectorFileSize(length, width));
+}
+
+// Writes the index of a text to files sharing a prefix, returning whether it succeeded
+//
+// EXTRA INFO:
+// - Files are: prefix.text (S), prefix.invsa, prefix.lcp, and prefix.rmq1 (the table 'A') or prefix.rmq2 (sdsl serialized 'rmq')
+// - For Type 2 RMQs, prefix.lcp holds the bit-compressed LCP array as serialized by sdsl
+//
+// INPUT:
+// - Prefix of index filenames
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Inverse Suffix Array
+// - Longest Common Prefix Array
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+bool storeIndex(string prefix, unsigned char* S, INT S_n, INT * invSA, INT * LCP, INT * A) {
+#else
+// Using Type 2 RMQs
+bool storeIndex(string prefix, unsigned char* S, INT S_n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq) {
+#endif
+    int width = 8 * sizeof(INT);
+
+    bool stored = storeVector(prefix + ".text", S, S_n, 8)
+                  and storeVector(prefix + ".invsa", invSA, S_n, width);
+
+    #ifdef _USE_NLOGN_RMQ
+        stored = stored and storeVector(prefix + ".lcp", LCP, S_n, width)
+                        and storeVector(prefix + ".rmq1", A, S_n * flog2(S_n), width);
+    #else
+        stored = stored and store_to_file(LCP, prefix + ".lcp")
+                        and store_to_file(rmq, prefix + ".rmq2");
+    #endif
+
+    return stored;
+}
+
+// Opens the index of a text from files written by storeIndex, returning whether it was found and built for the same text
+//
+// EXTRA INFO:
+// - invSA (with LCP and 'A' for Type 1 RMQs) are mapped read-only from their files; the bit-compressed LCP and 'rmq' for Type 2
+//   RMQs are small, so are loaded
+//
+// INPUT:
+// - Prefix of index filenames
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Inverse Suffix Array, Longest Common Prefix Array and RMQ data to fill (Type 1: 'A', Type 2: 'rmq')
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+bool openIndex(string prefix, unsigned char* S, INT S_n, INT ** invSA, INT ** LCP, INT ** A) {
+#else
+// Using Type 2 RMQs
+bool openIndex(string prefix, unsigned char* S, INT S_n, INT ** invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq) {
+#endif
+    int width = 8 * sizeof(INT);
+    unsigned char * text = (unsigned char *) mapVector(prefix + ".text", S_n, 8);
+
+    if (text == NULL) {
+        return false;
+    }
+
+    bool same_text = (memcmp(text, S, S_n) == 0);
+    unmapVector(text, S_n, 8);
+
+    if (!same_text) {
+        return false;
+    }
+
+    *invSA = (INT *) mapVector(prefix + ".invsa", S_n, width);
+
+    #ifdef _USE_NLOGN_RMQ
+        *LCP = (INT *) mapVector(prefix + ".lcp", S_n, width);
+        *A = (INT *) mapVector(prefix + ".rmq1", S_n * flog2(S_n), width);
+        bool opened = (*LCP != NULL and *A != NULL);
+    #else
+        bool opened = load_from_file(LCP, prefix + ".lcp") and LCP.size() == (uint64_t) S_n
+                      and load_from_file(rmq, prefix + ".rmq2") and rmq.size() == (uint64_t) S_n;
+    #endif
+
+    if (*invSA == NULL or !opened) {
+        if (*invSA != NULL) unmapVector(*invSA, S_n, width);
+
+        #ifdef _USE_NLOGN_RMQ
+            if (*LCP != NULL) unmapVector(*LCP, S_n, width);
+            if (*A != NULL) unmapVector(*A, S_n * flog2(S_n), width);
+        #endif
+
+        return false;
+    }
+
+    return true;
+}
+
+// Removes the files of an index written by storeIndex
+//
+// INPUT:
+// - Prefix of index filenames
+void removeIndex(string prefix) {
+    for (string extension : { ".text", ".invsa", ".lcp", ".rmq1", ".rmq2" }) {
+        unlink((prefix + extension).c_str());
+    }
+}
+
+
+////////////////////////
+//  STRING FUNCTIONS  //
+////////////////////////
+
+// Calculates the Longest Common Prefix array of a text and stores value in given variable LCP
+//
+// INPUT:
+// - Text
+// - Text length
+// - Suffix Array
+// - Longest Common Prefix data structure (empty)
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+unsigned int LCParray(unsigned char *text, INT n, INT * SA, INT * invSA, INT * LCP)
+#else
+// Using Type 2 RMQs
+unsigned int LCParray(unsigned char *text, INT n, INT * SA, INT * invSA, int_vector<> &LCP)
+#endif
+{
+    INT i = 0, j = 0;
+    LCP[0] = 0;
+
+    for (i = 0; i < n; i++) {
+        if (invSA[i] != 0) {
+            if ( i == 0) {
+                j = 0;
+            }
+            else {
+                j = (LCP[invSA[i-1]] >= 2) ? LCP[invSA[i-1]]-1 : 0;
+            }
+
+            while ( text[i+j] == text[SA[invSA[i]-1]+j] ) {
+                j++;
+            }
+
+            LCP[invSA[i]] = j;
+        }
+    }
+
+    return 1;
+}
+
+// Returns the Longest Common Extension between position i and j (order of i, j input does not matter)
+//
+// INPUT:
+// - Indexes i and j
+// - Text length
+// - Inverse Suffix Array
+// - Longest Common Prefix Array data structure (filled)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+unsigned int LCE(INT i, INT j, INT n, INT * invSA, INT * LCP, INT * A) {
+#else
+// Using Type 2 RMQs
+unsigned int LCE(INT i, INT j, INT n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq) {
+#endif
+    if (i == j) {
+        return n - i;
+    }
+
+    // Nothing to compare beyond the end of the text
+    if (i >= n or j >= n) {
+        return 0;
+    }
+
+    INT a = invSA[i];
+    INT b = invSA[j];
+    INT c = 0;
+
+    if (a > b) {
+        c = a;
+        a = b;
+        b = c;
+    }
+
+    #ifdef _USE_NLOGN_RMQ
+        return LCP[rmq(A, LCP, n, a, b)]; // Using Type 1 RMQs: rmq(a, b) does not include 'a' value in range
+    #else
+        return LCP[rmq(a + 1, b)]; // Using Type 2 RMQs: rmq(a, b) does include 'a' value in range
+    #endif
+}
+
+// Returns the Longest Common Extension between position i and j of a text containing unique sentinels
+//
+// EXTRA INFO:
+// - Compares up to a small number of characters directly before resorting to a Range Minimum Query, as most
+//   extensions between unrelated positions are short and direct comparisons avoid random memory accesses
+// - i and j must differ, and the text must end each half with a unique sentinel (as S does with '$' and '#')
+//
+// INPUT:
+// - Text
+// - Indexes i and j
+// - Text length
+// - Inverse Suffix Array
+// - Longest Common Prefix Array data structure (filled)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+#define DIRECT_LCE_LIMIT 16
+
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+static __inline unsigned int directLCE(unsigned char* text, INT i, INT j, INT n, INT * invSA, INT * LCP, INT * A) {
+#else
+// Using Type 2 RMQs
+static __inline unsigned int directLCE(unsigned char* text, INT i, INT j, INT n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq) {
+#endif
+    unsigned int l = 0;
+
+    while (text[i + l] == text[j + l]) {
+        l++;
+
+        if (l == DIRECT_LCE_LIMIT) {
+            #ifdef _USE_NLOGN_RMQ
+            return l + LCE(i + l, j + l, n, invSA, LCP, A);
+            #else
+            return l + LCE(i + l, j + l, n, invSA, LCP, rmq);
+            #endif
+        }
+    }
+
+    return l;
+}
+
+// Returns the Longest Common Extension between position i (first half of S) and j (second half of S), for texts holding only 'a', 'c', 'g', 't'
+//
+// EXTRA INFO:
+// - Compares 8 characters at a time as 64-bit words, taking the first difference from the trailing zeros of their XOR, for up to
+//   32 characters before resorting to a Range Minimum Query
+// - The unique '$' and '#' ending the halves of S stop the comparison, so S must be followed by 8 bytes of padding
+//
+// INPUT:
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Indexes i and j
+// - Length of S
+// - Inverse Suffix Array
+// - Longest Common Prefix Array data structure (filled)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+static __inline unsigned int wordLCE(unsigned char* S, INT i, INT j, INT S_n, INT * invSA, INT * LCP, INT * A) {
+#else
+// Using Type 2 RMQs
+static __inline unsigned int wordLCE(unsigned char* S, INT i, INT j, INT S_n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq) {
+#endif
+    // Nothing to compare beyond either end
+    if (i >= S_n / 2 or j >= S_n) {
+        return 0;
+    }
+
+    for (int l = 0; l < 32; l += 8) {
+        uint64_t a, b;
+        memcpy(&a, S + i + l, 8);
+        memcpy(&b, S + j + l, 8);
+
+        if (a != b) {
+            return l + __builtin_ctzll(a ^ b) / 8;
+        }
+    }
+
+    #ifdef _USE_NLOGN_RMQ
+    return 32 + LCE(i + 32, j + 32, S_n, invSA, LCP, A);
+    #else
+    return 32 + LCE(i + 32, j + 32, S_n, invSA, LCP, rmq);
+    #endif
+}
+
+// Calculates a list of Longest Common Extensions, corresponding to 0, 1, 2, etc. allowed mismatches, up to maximum number of allowed mismatches,
+// and returns the number of Longest Common Extensions made
+//
+// EXTRA INFO:
+// - Only considers "real" mismatches (degenerate string mismatching according to IUPAC character matrix)
+// - Takes into account the matching possibility of non A, C, G, T/U characters
+// - Longest Common Extension calculated from positions i and j (order of i, j input does not matter)
+// - Only starts counting number of allowed mismatches that occur after the given initial gap, however earlier mismatches are still stored
+// - Stops early once two mismatches that could end a palindrome lie beyond initial gap + maximum length, as later mismatches cannot change the (truncated) output
+// - Should only be used after MatchMatrix has been instantiated with necessary data
+//
+// INPUT:
+// - Text
+// - Indexes i and j
+// - Text length
+// - Inverse Suffix Array
+// - Longest Common Prefix Array (LCP)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+// - Maximum number of allowed mismatches
+// - Initial gap
+// - Maximum length of palindrome
+// - Data structure to store resulting mismatch locations
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+int realLCE_mismatches(unsigned char* text, INT i, INT j, INT n, INT * invSA, INT * LCP, INT * A, int mismatches, int initial_gap, int max_len, list<int>* mismatch_locs) {
+#else
+// Using Type 2 RMQs
+int realLCE_mismatches(unsigned char* text, INT i, INT j, INT n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq, int mismatches, int initial_gap, int max_len, list<int>* mismatch_locs) {
+#endif
+    int jumps = 0;
+
+    if ( i == j ) {
+        mismatch_locs->push_back( n - i );
+    }
+    else {
+        int real_lce = 0;
+
+        // Any palindrome ending at or beyond this location is truncated to max_len
+        int bound = initial_gap + max_len;
+        int prev_mismatch = -1;
+        int ends_beyond_bound = 0;
+
+        while (mismatches >= 0) {
+            #ifdef _USE_NLOGN_RMQ
+            real_lce = real_lce + LCE(i + real_lce, j + real_lce, n, invSA, LCP, A);
+            #else
+            real_lce = real_lce + LCE(i + real_lce, j + real_lce, n, invSA, LCP, rmq);
+            #endif
+            jumps++;
+
+            if ( i + real_lce >= (n / 2) or j + real_lce >= n ) {
+                break;
+            }
+
+            char s1 = text[i + real_lce];
+            char s2 = text[j + real_lce];
+
+            if ( !MatchMatrix::match(s1, s2) ) {
+
+                mismatch_locs->push_back( real_lce );
+                if (real_lce >= initial_gap) {
+                    mismatches--;
+                }
+
+                // A mismatch not directly following another may mark the end of a palindrome,
+                // two of these beyond the bound fix every truncated palindrome and its final character
+                if (real_lce >= bound and real_lce != prev_mismatch + 1) {
+                    ends_beyond_bound++;
+
+                    if (ends_beyond_bound == 2) {
+                        break;
+                    }
+                }
+
+                prev_mismatch = real_lce;
+            }
+
+            real_lce++;
+        }
+    }
+
+    return jumps;
+}
+
+// Adds a palindrome to an output buffer if it is long enough, truncating it to maximum length if required, and returns whether
+// it was truncated
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - Left, right indexes and gap of potential palindrome
+// - Minimum and maximum length of palindromes
+// - End mismatch of potential palindrome and the valid end mismatch preceding it (-1 if there is none)
+static __inline bool insertPalindrome(P_buffer* palindromes, int left, int right, int gap, int min_len, int max_len, int end_mismatch, int prev_end_mismatch) {
+    // Check that potential palindrome is not too short
+    if ((right - left + 1 - gap) / 2 >= min_len) {
+        // Check that potential palindrome is not too long
+        if ((right - left + 1 - gap) / 2 <= max_len) {
+            // Palindrome is not too long, so add to output
+            palindromes->push_back(tuple<int, int, int>(left, right, gap));
+        }
+        else {
+            // Palindrome is too long, so attempt truncation
+            int mismatch_gap = end_mismatch - prev_end_mismatch - 1;
+            int overshoot = ( (right - left + 1 - gap) / 2 ) - max_len;
+
+            // Check if truncation results in the potential palindrome ending in a mismatch
+            if (overshoot != mismatch_gap) {
+                // Potential palindrome does not end in a mismatch, so add to output
+                palindromes->push_back(tuple<int, int, int>(left + overshoot, right - overshoot, gap));
+            }
+            else {
+                // Potential palindrome does end in a mismatch, so truncate an additional 1 character either side then add to output
+                palindromes->push_back(tuple<int, int, int>(left + overshoot + 1, right - overshoot - 1, gap));
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Finds all inverted repeats (palindromes) with given parameters and adds them to an output buffer
+//
+// EXTRA INFO:
+// - Generic version handling any number of allowed mismatches, by building lists of mismatch locations per centre
+// - STATS is set to count the work of each centre (see ScanStats)
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Text length
+// - Inverse Suffix Array
+// - Longest Common Prefix Array (LCP)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap)
+// - Bit vector marking the centres c to check at index 2c, or NULL to check every centre
+// - Range of centres to check (k_from <= c < k_to)
+template<bool STATS>
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+void addPalindromesGeneric(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, INT * LCP, INT * A, tuple<int, int, int, int> params, bit_vector* centres, int k_from, int k_to) {
+#else
+// Using Type 2 RMQs
+void addPalindromesGeneric(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq, tuple<int, int, int, int> params, bit_vector* centres, int k_from, int k_to) {
+#endif
+    // Retrieve parameters from tuple
+    int min_len = get<0>(params);
+    int max_len = get<1>(params);
+    int mismatches = get<2>(params);
+    int max_gap = get<3>(params);
+
+    ScanStats* stats = STATS ? threadStats() : NULL;
+
+    // Cycle through possible centres of text from left to right
+    for (double c = k_from; c <= (n - 1) and c < k_to; c += 0.5 ) {
+        if (centres != NULL and !(*centres)[int(2.0 * c)]) {
+            continue;
+        }
+
+        // Determine if value of centre corresponds to an odd or even palindrome
+        bool isOdd = (trunc(c) == c);
+
+        // Strategically choose i and j to determine maximum extension with text
+        int i, j;
+
+        if (isOdd) {
+            i = int(c + 1.0);
+            j = int(2.0 * n + 1.0 - c);
+        } else {
+            i = int(c + 0.5);
+            j = int(2.0 * n + 1.0 - (c + 0.5));
+        }
+
+        // Calculate initial number of characters ignored when performing Longest Common Extensions to determine palindromes
+        int initial_gap;
+
+        if (max_gap % 2 == 1) {
+            initial_gap = (max_gap - 1) / 2;
+        }
+        else {
+            if (isOdd) {
+                initial_gap = (max_gap - 2) / 2;
+            } else {
+                initial_gap = max_gap / 2;
+            }
+        }
+
+        // Calculate list of relevant mismatch locations when performing Longest Common Extensions in 'kangaroo method' style
+        list<int> mismatch_locs;
+        int jumps;
+
+        #ifdef _USE_NLOGN_RMQ
+            jumps = realLCE_mismatches(S, i, j, S_n, invSA, LCP, A, mismatches, initial_gap, max_len, &mismatch_locs);
+        #else
+            jumps = realLCE_mismatches(S, i, j, S_n, invSA, LCP, rmq, mismatches, initial_gap, max_len, &mismatch_locs);
+        #endif
+
+        size_t found = palindromes->size();
+        int starts = 0;
+
+        // Every extension is found by a Range Minimum Query
+        if (STATS) {
+            stats->rmq_queries += jumps;
+
+            for (int loc : mismatch_locs) {
+                (loc < initial_gap ? stats->gap_mismatches : stats->arm_mismatches)++;
+            }
+        }
+
+        // Always set -1 as a mismatch location
+        mismatch_locs.push_front(-1);
+
+        // Create data structures to store valid start and end mismatch locations alongside an ID value (mismatch_location, mismatch_id)
+        list<pair<int, int>> valid_start_locs, valid_end_locs;
+
+        // Determine list of valid start and end mismatch locations (that could mark the potential start or end of a palindrome)
+        int mismatch_id = 0;
+        for (list<int>::iterator it = mismatch_locs.begin(); it != mismatch_locs.end(); ++it){
+            if (next(it) != mismatch_locs.end() and *next(it) != *it + 1) {
+                valid_start_locs.push_back(pair<int, int> (*it, mismatch_id));
+            }
+
+            if (it != mismatch_locs.begin() and *prev(it) != *it - 1) {
+                valid_end_locs.push_back(pair<int, int> (*it, mismatch_id));
+            }
+
+            mismatch_id++;
+        }
+
+        // Check if valid start and end mismatch locations have been found
+        if ( !valid_start_locs.empty() and !valid_end_locs.empty() ) {
+            list<pair<int, int>>::iterator start_it = valid_start_locs.begin();
+            list<pair<int, int>>::iterator end_it = valid_end_locs.begin();
+
+            int mismatch_diff, left, right, gap;
+        	int start_mismatch, end_mismatch;
+
+            // End mismatch of the previously considered start, and whether that palindrome exceeded max_len
+            int prev_end_mismatch_used = -1;
+            bool prev_truncated = false;
+
+            // Loop while start mismatch locations have not reached the end of their list
+            while( start_it != valid_start_locs.end() ) {
+                start_mismatch = start_it->first; // Pick the current start mismatch
+
+                // Skip this iteration if the start mismatch chosen is such that the gap is not within the acceptable bound
+                if (start_mismatch >= initial_gap ) {
+                	break;
+                }
+
+                starts++;
+
+                // While mismatch difference is within acceptable bound, move end location to the right until mismatch difference becomes unacceptable
+                while (end_it != valid_end_locs.end()) {
+                    // Count the difference in mismatches between the start and end location
+                    mismatch_diff = end_it->second - start_it->second - 1;
+
+                    if (mismatch_diff > mismatches) {
+                        break;
+                    }
+
+                    end_it = next(end_it);
+                }
+
+                end_mismatch = prev(end_it)->first; // Pick the end mismatch directly before the first unacceptable end mismatch
+
+                // A start sharing its end mismatch with the previous start gives a palindrome contained within the previous one,
+                // unless the previous one was truncated to max_len (its outer edges then differ), so skip it
+                if (end_mismatch == prev_end_mismatch_used and !prev_truncated) {
+                    start_it = next(start_it);
+                    continue;
+                }
+
+                // Set left, right indexes and gap of potential palindrome, according to chosen start and end mismatch
+                if (isOdd) {
+	                left = int(c - end_mismatch);
+	                right = int(c + end_mismatch);
+	                gap = 2 * (start_mismatch + 1) + 1;
+	            }
+	            else {
+	                left = int(c - 0.5 - (end_mismatch - 1.0));
+	                right = int(c + 0.5 + (end_mismatch - 1.0));
+	                gap = 2 * (start_mismatch + 1);
+	            }
+
+                prev_end_mismatch_used = end_mismatch;
+                prev_truncated = ((right - left + 1 - gap) / 2 > max_len);
+
+                // The first end mismatch is preceded only by the implicit mismatch at -1
+                int prev_end_mismatch = (prev(end_it) != valid_end_locs.begin()) ? prev(prev(end_it))->first : -1;
+
+                bool truncated = insertPalindrome(palindromes, left, right, gap, min_len, max_len, end_mismatch, prev_end_mismatch);
+
+                if (STATS and truncated) {
+                    stats->truncated++;
+                }
+
+                // Go to next start mismatch in list and loop
+                start_it = next(start_it);
+            }
+        }
+
+        if (STATS) {
+            countCentre(stats, jumps, starts, palindromes->size() - found);
+        }
+    }
+}
+
+// Pairs valid start and end mismatch locations of a single centre, for a fixed number of allowed mismatches, as the mismatch
+// locations are found from left to right, and adds the resulting palindromes to an output buffer
+//
+// EXTRA INFO:
+// - Produces the same palindromes as addPalindromesGeneric for the centre
+// - Odd palindromes are centred on c = k, even palindromes on c = k + 0.5
+// - A start mismatch stays pending until an end mismatch more than K mismatches after it is found, so at most K + 2 starts are
+//   pending at once and are held in fixed-size arrays
+// - STATS is set to count the valid starts within the initial gap and the palindromes truncated to max_len
+template<int K, bool ODD, bool STATS = false>
+class CentreMismatches {
+    public:
+        CentreMismatches(P_buffer* palindromes, int k, int min_len, int max_len, int initial_gap)
+            : palindromes(palindromes), k(k), min_len(min_len), max_len(max_len), initial_gap(initial_gap), bound(initial_gap + max_len) {}
+
+        // Counts kept when STATS is set
+        int starts = 0;
+        int truncated = 0;
+
+        // Adds the next mismatch location, returning false once later mismatch locations can no longer change the palindromes found
+        bool add(int loc) {
+            mismatch_id++;
+
+            // A mismatch not directly following another is a valid end, and makes the previous mismatch a valid start
+            if (loc != prev_mismatch + 1) {
+                if (prev_mismatch < initial_gap) {
+                    int slot = pending_head + pending_count;
+                    slot = (slot >= K + 2) ? slot - (K + 2) : slot;
+                    start_loc[slot] = prev_mismatch;
+                    start_id[slot] = mismatch_id - 1;
+                    pending_count++;
+
+                    if (STATS) {
+                        starts++;
+                    }
+                }
+
+                // Pending starts with too many mismatches before this end take the previous valid end
+                while (pending_count > 0 and mismatch_id - start_id[pending_head] - 1 > K) {
+                    resolveStart();
+                }
+
+                prev_end_mismatch = end_mismatch;
+                end_mismatch = loc;
+
+                if (loc >= bound) {
+                    ends_beyond_bound++;
+                }
+            }
+
+            if (loc >= initial_gap) {
+                mismatches_left--;
+            }
+
+            prev_mismatch = loc;
+
+            // Two valid ends beyond the bound fix every truncated palindrome (see realLCE_mismatches)
+            return mismatches_left >= 0 and ends_beyond_bound < 2;
+        }
+
+        // Remaining pending starts all pair with the last valid end mismatch
+        void finish() {
+            while (pending_count > 0) {
+                resolveStart();
+            }
+        }
+
+    private:
+        P_buffer* palindromes;
+        int k, min_len, max_len, initial_gap, bound;
+
+        // Pending start mismatches (location, mismatch_id), oldest first
+        int start_loc[K + 2];
+        int start_id[K + 2];
+        int pending_head = 0;
+        int pending_count = 0;
+
+        // Most recent mismatch and its id (-1 is always a mismatch location, with id 0)
+        int prev_mismatch = -1;
+        int mismatch_id = 0;
+
+        // Most recent valid end mismatch and the valid end mismatch preceding it
+        int end_mismatch = -1;
+        int prev_end_mismatch = -1;
+
+        // End mismatch of the previously considered start, and whether that palindrome exceeded max_len
+        int prev_end_mismatch_used = -1;
+        bool prev_truncated = false;
+
+        int mismatches_left = K;
+        int ends_beyond_bound = 0;
+
+        // Resolves the oldest pending start, pairing it with the current valid end mismatch
+        void resolveStart() {
+            int start_mismatch = start_loc[pending_head];
+            pending_head = (pending_head + 1 == K + 2) ? 0 : pending_head + 1;
+            pending_count--;
+
+            // Skip starts whose palindrome is contained within the previous one (see addPalindromesGeneric)
+            if (end_mismatch == prev_end_mismatch_used and !prev_truncated) {
+                return;
+            }
+
+            int left, right, gap;
+
+            if (ODD) {
+                left = k - end_mismatch;
+                right = k + end_mismatch;
+                gap = 2 * (start_mismatch + 1) + 1;
+            }
+            else {
+                left = k - end_mismatch + 1;
+                right = k + end_mismatch;
+                gap = 2 * (start_mismatch + 1);
+            }
+
+            prev_end_mismatch_used = end_mismatch;
+            prev_truncated = ((right - left + 1 - gap) / 2 > max_len);
+
+            if (insertPalindrome(palindromes, left, right, gap, min_len, max_len, end_mismatch, prev_end_mismatch) and STATS) {
+                truncated++;
+            }
+        }
+};
+
+// Finds all inverted repeats (palindromes) centred at one parity of centre, for a fixed number of allowed mismatches, and adds them to an output buffer
+//
+// EXTRA INFO:
+// - Produces the same palindromes as addPalindromesGeneric for the centres it covers
+// - Odd palindromes are centred on c = k, even palindromes on c = k + 0.5, so centres are visited with integer indexes only
+// - Mismatch locations are consumed as soon as the 'kangaroo method' finds them, rather than stored in lists
+// - PURE is set for texts holding only 'a', 'c', 'g', 't': extensions then come from wordLCE, and the characters ending them
+//   always mismatch, so are not checked against the match matrix
+// - STATS is set to count the work of each centre (see ScanStats)
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Text length
+// - Inverse Suffix Array
+// - Longest Common Prefix Array (LCP)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+// - Minimum length, maximum length and maximum gap of palindromes
+// - Bit vector marking the centres c to check at index 2c, or NULL to check every centre
+// - Range of centres to check (k_from <= k < k_to)
+template<int K, bool ODD, bool PURE, bool STATS>
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+void addPalindromesFixed(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, INT * LCP, INT * A, int min_len, int max_len, int max_gap, bit_vector* centres, int k_from, int k_to) {
+#else
+// Using Type 2 RMQs
+void addPalindromesFixed(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq, int min_len, int max_len, int max_gap, bit_vector* centres, int k_from, int k_to) {
+#endif
+    // Calculate initial number of characters ignored when performing Longest Common Extensions, which only depends on the parity of the centre
+    int initial_gap;
+
+    if (max_gap % 2 == 1) {
+        initial_gap = (max_gap - 1) / 2;
+    }
+    else {
+        initial_gap = ODD ? (max_gap - 2) / 2 : max_gap / 2;
+    }
+
+    int last_centre = min(ODD ? n - 1 : n - 2, k_to - 1);
+    ScanStats* stats = STATS ? threadStats() : NULL;
+
+    for (int k = k_from; k <= last_centre; k++) {
+        if (centres != NULL and !(*centres)[ODD ? 2 * k : 2 * k + 1]) {
+            continue;
+        }
+
+        // Strategically choose i and j to determine maximum extension with text
+        INT i = k + 1;
+        INT j = ODD ? 2 * n + 1 - k : 2 * n - k;
+
+        CentreMismatches<K, ODD, STATS> centre(palindromes, k, min_len, max_len, initial_gap);
+        int real_lce = 0;
+        int jumps = 0;
+        size_t found = palindromes->size();
+
+        // Perform Longest Common Extensions in 'kangaroo method' style, only counting mismatches after the initial gap
+        while (true) {
+            int extended = real_lce;
+
+            #ifdef _USE_NLOGN_RMQ
+            real_lce = real_lce + (PURE ? wordLCE(S, i + real_lce, j + real_lce, S_n, invSA, LCP, A) : LCE(i + real_lce, j + real_lce, S_n, invSA, LCP, A));
+            #else
+            real_lce = real_lce + (PURE ? wordLCE(S, i + real_lce, j + real_lce, S_n, invSA, LCP, rmq) : LCE(i + real_lce, j + real_lce, S_n, invSA, LCP, rmq));
+            #endif
+
+            // wordLCE compares up to 32 characters directly, while LCE always makes a Range Minimum Query
+            if (STATS) {
+                jumps++;
+                stats->rmq_queries += (!PURE or real_lce - extended >= 32) ? 1 : 0;
+            }
+
+            if ( i + real_lce >= (S_n / 2) or j + real_lce >= S_n ) {
+                break;
+            }
+
+            if ( PURE or !MatchMatrix::match(S[i + real_lce], S[j + real_lce]) ) {
+                if (STATS) {
+                    (real_lce < initial_gap ? stats->gap_mismatches : stats->arm_mismatches)++;
+                }
+
+                if (!centre.add(real_lce)) {
+                    break;
+                }
+            }
+
+            real_lce++;
+        }
+
+        centre.finish();
+
+        if (STATS) {
+            stats->truncated += centre.truncated;
+            countCentre(stats, jumps, centre.starts, palindromes->size() - found);
+        }
+    }
+}
+
+// Finds all inverted repeats (palindromes) for a fixed number of allowed mismatches, covering odd and even centres (taking the faster path when the text holds only 'a', 'c', 'g', 't')
+template<int K, bool STATS>
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+void addPalindromesFixed(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, INT * LCP, INT * A, int min_len, int max_len, int max_gap, bit_vector* centres, bool pure_bases, int k_from, int k_to) {
+    if (pure_bases) {
+        addPalindromesFixed<K, true, true, STATS>(palindromes, S, S_n, n, invSA, LCP, A, min_len, max_len, max_gap, centres, k_from, k_to);
+        addPalindromesFixed<K, false, true, STATS>(palindromes, S, S_n, n, invSA, LCP, A, min_len, max_len, max_gap, centres, k_from, k_to);
+    } else {
+        addPalindromesFixed<K, true, false, STATS>(palindromes, S, S_n, n, invSA, LCP, A, min_len, max_len, max_gap, centres, k_from, k_to);
+        addPalindromesFixed<K, false, false, STATS>(palindromes, S, S_n, n, invSA, LCP, A, min_len, max_len, max_gap, centres, k_from, k_to);
+    }
+}
+#else
+// Using Type 2 RMQs
+void addPalindromesFixed(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq, int min_len, int max_len, int max_gap, bit_vector* centres, bool pure_bases, int k_from, int k_to) {
+    if (pure_bases) {
+        addPalindromesFixed<K, true, true, STATS>(palindromes, S, S_n, n, invSA, LCP, rmq, min_len, max_len, max_gap, centres, k_from, k_to);
+        addPalindromesFixed<K, false, true, STATS>(palindromes, S, S_n, n, invSA, LCP, rmq, min_len, max_len, max_gap, centres, k_from, k_to);
+    } else {
+        addPalindromesFixed<K, true, false, STATS>(palindromes, S, S_n, n, invSA, LCP, rmq, min_len, max_len, max_gap, centres, k_from, k_to);
+        addPalindromesFixed<K, false, false, STATS>(palindromes, S, S_n, n, invSA, LCP, rmq, min_len, max_len, max_gap, centres, k_from, k_to);
+    }
+}
+#endif
+
+// Finds all exact inverted repeats (palindromes with no mismatches) centred at one parity of centre, and adds them to an output buffer
+//
+// EXTRA INFO:
+// - Produces the same palindromes as addPalindromesGeneric with 0 allowed mismatches for the centres it covers
+// - With no mismatches allowed every palindrome lies between two consecutive mismatch locations, the first of them within the initial gap,
+//   so each centre only needs the Longest Common Extensions up to its first mismatch beyond the initial gap
+// - A truncated palindrome can never end in a mismatch, so no earlier mismatch locations need to be kept
+// - Short extensions are found by direct character comparison, so Range Minimum Queries are only made for long ones
+// - PURE is set for texts holding only 'a', 'c', 'g', 't': extensions then come from wordLCE, and the characters ending them
+//   always mismatch, so are not checked against the match matrix
+// - STATS is set to count the work of each centre (see ScanStats)
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Text length
+// - Inverse Suffix Array
+// - Longest Common Prefix Array (LCP)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+// - Minimum length, maximum length and maximum gap of palindromes
+// - Bit vector marking the centres c to check at index 2c, or NULL to check every centre
+// - Range of centres to check (k_from <= k < k_to)
+template<bool ODD, bool PURE, bool STATS>
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+void addPalindromesExact(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, INT * LCP, INT * A, int min_len, int max_len, int max_gap, bit_vector* centres, int k_from, int k_to) {
+#else
+// Using Type 2 RMQs
+void addPalindromesExact(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq, int min_len, int max_len, int max_gap, bit_vector* centres, int k_from, int k_to) {
+#endif
+    int initial_gap;
+
+    if (max_gap % 2 == 1) {
+        initial_gap = (max_gap - 1) / 2;
+    }
+    else {
+        initial_gap = ODD ? (max_gap - 2) / 2 : max_gap / 2;
+    }
+
+    // No start mismatch can lie before the initial gap
+    if (initial_gap < 0) {
+        return;
+    }
+
+    int last_centre = min(ODD ? n - 1 : n - 2, k_to - 1);
+    ScanStats* stats = STATS ? threadStats() : NULL;
+
+    for (int k = k_from; k <= last_centre; k++) {
+        if (centres != NULL and !(*centres)[ODD ? 2 * k : 2 * k + 1]) {
+            continue;
+        }
+
+        INT i = k + 1;
+        INT j = ODD ? 2 * n + 1 - k : 2 * n - k;
+
+        int prev_mismatch = -1;
+        int real_lce = 0;
+        int jumps = 0;
+        int starts = 0;
+        size_t found = palindromes->size();
+
+        while (true) {
+            int extended = real_lce;
+
+            #ifdef _USE_NLOGN_RMQ
+            real_lce = real_lce + (PURE ? wordLCE(S, i + real_lce, j + real_lce, S_n, invSA, LCP, A) : directLCE(S, i + real_lce, j + real_lce, S_n, invSA, LCP, A));
+            #else
+            real_lce = real_lce + (PURE ? wordLCE(S, i + real_lce, j + real_lce, S_n, invSA, LCP, rmq) : directLCE(S, i + real_lce, j + real_lce, S_n, invSA, LCP, rmq));
+            #endif
+
+            // Both compare characters directly before making a Range Minimum Query
+            if (STATS) {
+                jumps++;
+                stats->rmq_queries += (real_lce - extended >= (PURE ? 32 : DIRECT_LCE_LIMIT)) ? 1 : 0;
+            }
+
+            if ( i + real_lce >= (S_n / 2) or j + real_lce >= S_n ) {
+                break;
+            }
+
+            if ( PURE or !MatchMatrix::match(S[i + real_lce], S[j + real_lce]) ) {
+                // Matching characters between the previous mismatch (within the initial gap) and this one form the arms of a palindrome
+                int arm = real_lce - prev_mismatch - 1;
+
+                if (STATS) {
+                    (real_lce < initial_gap ? stats->gap_mismatches : stats->arm_mismatches)++;
+                    starts += (arm > 0) ? 1 : 0;
+                    stats->truncated += (arm >= min_len and arm > max_len) ? 1 : 0;
+                }
+
+                if (arm >= min_len) {
+                    int overshoot = (arm > max_len) ? arm - max_len : 0;
+                    int left, right, gap;
+
+                    if (ODD) {
+                        left = k - real_lce;
+                        right = k + real_lce;
+                        gap = 2 * (prev_mismatch + 1) + 1;
+                    }
+                    else {
+                        left = k - real_lce + 1;
+                        right = k + real_lce;
+                        gap = 2 * (prev_mismatch + 1);
+                    }
+
+                    palindromes->push_back(tuple<int, int, int>(left + overshoot, right - overshoot, gap));
+                }
+
+                if (real_lce >= initial_gap) {
+                    break;
+                }
+
+                prev_mismatch = real_lce;
+            }
+
+            real_lce++;
+        }
+
+        if (STATS) {
+            countCentre(stats, jumps, starts, palindromes->size() - found);
+        }
+    }
+}
+
+// Number of offsets from each centre whose mismatches are found bit-parallel by the diagonal engine (one 64-bit word)
+#define DIAGONAL_SPAN 64
+
+// Cost of building the index, per character of S, in character comparisons (used to choose the diagonal engine)
+#define DIAGONAL_INDEX_COST 400
+
+// Cost of the bit-parallel work per centre of the diagonal engine, in character comparisons
+#define DIAGONAL_CENTRE_COST 20
+
+// Transposes a 64 x 64 bit matrix held in 64 words, so that bit j of word i becomes bit i of word j
+static __inline void transpose64(uint64_t* a) {
+    uint64_t m = 0x00000000FFFFFFFFULL;
+
+    for (int j = 32; j != 0; j >>= 1, m ^= (m << j)) {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k | j] ^= t;
+            a[k] ^= (t << j);
+        }
+    }
+}
+
+// Finds all inverted repeats (palindromes) centred at one parity of centre, for a fixed number of allowed mismatches, without any index
+//
+// EXTRA INFO:
+// - Produces the same palindromes as addPalindromesGeneric
+// - For each of the first DIAGONAL_SPAN offsets from the centre, whether characters match is found for 64 consecutive centres at once,
+//   by ANDing bit planes (one per base) of the text with those of its reverse complement, as IUPAC characters match if they share a base
+// - Transposing the 64 x 64 bit matrix gives each centre a word of mismatch locations, read in increasing order with ctz
+// - Centres with no window of min_len offsets (starting within the initial gap) holding at most K mismatches are skipped
+// - The few centres still undecided after DIAGONAL_SPAN offsets continue by direct character comparison
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Text length
+// - Bit planes of the text and of its complement (mirrored, so that position q holds the complement of text position q), padded by
+//   DIAGONAL_SPAN bits either side
+// - Minimum length, maximum length and maximum gap of palindromes
+// - Range of centres to check (k_from <= k < k_to)
+template<int K, bool ODD>
+void addPalindromesDiagonal(P_buffer* palindromes, unsigned char* S, int n, vector<uint64_t>* text_planes, vector<uint64_t>* comp_planes, int min_len, int max_len, int max_gap, int k_from, int k_to) {
+    int initial_gap;
+
+    if (max_gap % 2 == 1) {
+        initial_gap = (max_gap - 1) / 2;
+    }
+    else {
+        initial_gap = ODD ? (max_gap - 2) / 2 : max_gap / 2;
+    }
+
+    // Windows of min_len offsets, starting at offsets 0 to initial_gap, can be checked within one word
+    bool window_filter = (initial_gap >= 0 and initial_gap + min_len <= DIAGONAL_SPAN);
+    uint64_t window = (min_len == 64) ? ~0ULL : (1ULL << min_len) - 1;
+
+    int last_centre = min(ODD ? n - 1 : n - 2, k_to - 1);
+    uint64_t rows[64];
+
+    for (int k0 = k_from; k0 <= last_centre; k0 += 64) {
+        // Mismatches at each offset r for centres k0 to k0 + 63, which compare text position k + 1 + r with the complement of
+        // text position k - 1 - r (odd) or k - r (even)
+        for (int r = 0; r < DIAGONAL_SPAN; r++) {
+            long int p = DIAGONAL_SPAN + k0 + 1 + r;
+            long int q = DIAGONAL_SPAN + (ODD ? k0 - 1 - r : k0 - r);
+            uint64_t match = 0;
+
+            for (int b = 0; b < 4; b++) {
+                match |= getBits64(text_planes[b].data(), p) & getBits64(comp_planes[b].data(), q);
+            }
+
+            rows[r] = ~match;
+        }
+
+        transpose64(rows);
+
+        for (int lane = 0; lane < 64 and k0 + lane <= last_centre; lane++) {
+            int k = k0 + lane;
+
+            // Offset at which either end of the text is reached, always a mismatch location
+            int text_end = min(n - 1 - k, ODD ? k : k + 1);
+
+            uint64_t mismatch_word = rows[lane];
+
+            if (text_end < DIAGONAL_SPAN) {
+                mismatch_word &= (2ULL << text_end) - 1;
+            }
+
+            if (window_filter) {
+                bool found = false;
+
+                for (int a = 0; a <= initial_gap and !found; a++) {
+                    found = (__builtin_popcountll((mismatch_word >> a) & window) <= K);
+                }
+
+                if (!found) {
+                    continue;
+                }
+            }
+
+            CentreMismatches<K, ODD> centre(palindromes, k, min_len, max_len, initial_gap);
+            bool more = true;
+
+            while (mismatch_word != 0 and more) {
+                more = centre.add(__builtin_ctzll(mismatch_word));
+                mismatch_word &= mismatch_word - 1;
+            }
+
+            if (more and text_end >= DIAGONAL_SPAN) {
+                int i = k + 1;
+                int j = ODD ? 2 * n + 1 - k : 2 * n - k;
+
+                for (int r = DIAGONAL_SPAN; r <= text_end; r++) {
+                    if ( !MatchMatrix::match(S[i + r], S[j + r]) and !centre.add(r) ) {
+                        break;
+                    }
+                }
+            }
+
+            centre.finish();
+        }
+    }
+}
+
+// Finds all inverted repeats (palindromes) for a fixed number of allowed mismatches without any index, covering odd and even centres
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Text length
+// - Minimum length, maximum length and maximum gap of palindromes
+// - Number of threads to scan centres with
+template<int K>
+void addPalindromesDiagonal(P_buffer* palindromes, unsigned char* S, int n, int min_len, int max_len, int max_gap, int threads) {
+    // Bit planes for each base, with a bit set where a character of the text (or of the complement of the text) includes that base
+    long int words = (n + 2 * DIAGONAL_SPAN) / 64 + 2;
+    vector<uint64_t> text_planes[4], comp_planes[4];
+
+    for (int b = 0; b < 4; b++) {
+        text_planes[b].assign(words, 0);
+        comp_planes[b].assign(words, 0);
+    }
+
+    for (long int p = 0; p < n; p++) {
+        long int pos = DIAGONAL_SPAN + p;
+        int text_mask = MatchMatrix::IUPAC_to_mask[S[p]];
+        int comp_mask = MatchMatrix::IUPAC_to_mask[S[2 * n - p]];
+
+        for (int b = 0; b < 4; b++) {
+            text_planes[b][pos >> 6] |= uint64_t((text_mask >> b) & 1) << (pos & 63);
+            comp_planes[b][pos >> 6] |= uint64_t((comp_mask >> b) & 1) << (pos & 63);
+        }
+    }
+
+    scanCentres(palindromes, 0, n, threads, [&](P_buffer* buffer, int k_from, int k_to) {
+        addPalindromesDiagonal<K, true>(buffer, S, n, text_planes, comp_planes, min_len, max_len, max_gap, k_from, k_to);
+        addPalindromesDiagonal<K, false>(buffer, S, n, text_planes, comp_planes, min_len, max_len, max_gap, k_from, k_to);
+    });
+}
+
+// Finds all inverted repeats (palindromes) with given parameters without any index, and adds them to an output buffer
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Text length
+// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap),
+//   with at most 8 allowed mismatches
+// - Number of threads to scan centres with
+void addPalindromesDiagonal(P_buffer* palindromes, unsigned char* S, int n, tuple<int, int, int, int> params, int threads) {
+    int min_len = get<0>(params);
+    int max_len = get<1>(params);
+    int mismatches = get<2>(params);
+    int max_gap = get<3>(params);
+
+    #define DIAGONAL_CASE(K) case K: addPalindromesDiagonal<K>(palindromes, S, n, min_len, max_len, max_gap, threads); break;
+
+    switch (mismatches) {
+        DIAGONAL_CASE(0)
+        DIAGONAL_CASE(1)
+        DIAGONAL_CASE(2)
+        DIAGONAL_CASE(3)
+        DIAGONAL_CASE(4)
+        DIAGONAL_CASE(5)
+        DIAGONAL_CASE(6)
+        DIAGONAL_CASE(7)
+        DIAGONAL_CASE(8)
+    }
+
+    #undef DIAGONAL_CASE
+}
+
+// Returns whether the diagonal engine is expected to be faster than building the index used by the other engines
+//
+// EXTRA INFO:
+// - Each centre costs DIAGONAL_CENTRE_COST, plus one character comparison per offset scanned beyond DIAGONAL_SPAN
+// - Offsets scanned per centre are estimated as the initial gap plus the expected distance to the (mismatches + 1)-th mismatch, from
+//   the probability that a character of the text matches one of its complement (by base composition)
+// - Every centre within a run of fully degenerate characters ('n') scans to the end of the run, so these are counted separately
+// - Building the index costs DIAGONAL_INDEX_COST per character of S, which the diagonal engine must beat
+//
+// INPUT:
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Text length
+// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap)
+bool diagonalPreferred(unsigned char* S, int n, tuple<int, int, int, int> params) {
+    int mismatches = get<2>(params);
+    int max_gap = get<3>(params);
+
+    if (mismatches > 8) {
+        return false;
+    }
+
+    // Counts of bases masks in the text and its complement
+    double text_counts[16] = {0}, comp_counts[16] = {0};
+    double run_cost = 0.0;
+    long int run = 0;
+
+    for (long int p = 0; p < n; p++) {
+        int mask = MatchMatrix::IUPAC_to_mask[S[p]];
+        text_counts[mask]++;
+        comp_counts[MatchMatrix::IUPAC_to_mask[S[n + 1 + p]]]++;
+
+        run = (mask == 15) ? run + 1 : 0;
+        run_cost += run;
+    }
+
+    double P = 0.0;
+
+    for (int a = 0; a < 16; a++) {
+        for (int b = 0; b < 16; b++) {
+            if (a & b) {
+                P += (text_counts[a] / n) * (comp_counts[b] / n);
+            }
+        }
+    }
+
+    double scanned = (max_gap + 1) / 2 + (mismatches + 1) / max(1.0 - P, 1e-9);
+    double diagonal_cost = 2.0 * n * (DIAGONAL_CENTRE_COST + max(0.0, scanned - DIAGONAL_SPAN)) + run_cost;
+    double index_cost = (2.0 * n + 2) * DIAGONAL_INDEX_COST;
+
+    return diagonal_cost < index_cost;
+}
+
+// Finds all exact inverted repeats (palindromes with no mismatches) using a compressed suffix tree of S, and adds them to an output buffer
+//
+// EXTRA INFO:
+// - Produces the same palindromes as addPalindromesExact for texts holding only 'a', 'c', 'g', 't', whose characters match exactly when equal
+// - The right arm of a palindrome starts a suffix of the text, and its left arm reversed and complemented starts a suffix of the
+//   reverse complement, so every arm of at least min_len characters is a common prefix of two leaves of one node of string depth at
+//   least min_len; only the highest such nodes are visited, and the rest of the tree is skipped
+// - Leaves i (text) and j (reverse complement) of a node give an odd palindrome when i + j is even, with its arm starting at
+//   offset a = (i + j - 2n - 2) / 2 from centre k = i - 1 - a, and an even palindrome otherwise, with a = (i + j - 2n - 1) / 2
+// - Only leaves j placing a within the initial gap are visited, and a pair gives a palindrome when the characters before it differ (or a = 0)
+// - Time spent beyond building the tree depends on the number of such leaves rather than on the text length
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Text length
+// - Minimum length, maximum length and maximum gap of palindromes
+void addPalindromesSuffixTree(P_buffer* palindromes, unsigned char* S, int S_n, int n, int min_len, int max_len, int max_gap) {
+    int odd_gap = (max_gap % 2 == 1) ? (max_gap - 1) / 2 : (max_gap - 2) / 2;
+    int even_gap = (max_gap % 2 == 1) ? (max_gap - 1) / 2 : max_gap / 2;
+
+    cst_sct3<> cst;
+
+    {
+        PhaseScope scope(PHASE_SUFFIX_TREE);
+        string text((char*) S, S_n);
+        construct_im(cst, text.c_str(), 1);
+    }
+
+    vector<int> text_leaves, comp_leaves;
+
+    for (cst_sct3<>::const_iterator it = cst.begin(); it != cst.end(); ++it) {
+        if (it.visit() != 1) {
+            continue;
+        }
+
+        cst_sct3<>::node_type v = *it;
+        int depth = cst.depth(v);
+
+        if (depth < min_len) {
+            continue;
+        }
+
+        it.skip_subtree();
+
+        if (cst.is_leaf(v)) {
+            continue;
+        }
+
+        // Split leaves into suffixes of the text and of its reverse complement
+        text_leaves.clear();
+        comp_leaves.clear();
+
+        for (int idx = cst.lb(v); idx <= (int) cst.rb(v); idx++) {
+            int pos = cst.csa[idx];
+
+            if (pos < n) {
+                text_leaves.push_back(pos);
+            } else if (pos > n and pos < S_n - 1) {
+                comp_leaves.push_back(pos);
+            }
+        }
+
+        sort(comp_leaves.begin(), comp_leaves.end());
+
+        for (int i : text_leaves) {
+            vector<int>::iterator it_j = lower_bound(comp_leaves.begin(), comp_leaves.end(), 2 * n + 1 - i);
+
+            for (; it_j != comp_leaves.end() and *it_j <= 2 * n + 2 + 2 * even_gap - i; ++it_j) {
+                int j = *it_j;
+                bool odd = ((i + j) % 2 == 0);
+                int a = odd ? (i + j - 2 * n - 2) / 2 : (i + j - 2 * n - 1) / 2;
+                int k = i - 1 - a;
+
+                if (a > (odd ? odd_gap : even_gap) or k > (odd ? n - 1 : n - 2)) {
+                    continue;
+                }
+
+                // The arm must start after a mismatch (or at the centre)
+                if (a > 0 and S[i - 1] == S[j - 1]) {
+                    continue;
+                }
+
+                // Arm runs to the next mismatch, the unique '$' and '#' stopping it at either end of the text
+                int arm = depth;
+                while (S[i + arm] == S[j + arm]) {
+                    arm++;
+                }
+
+                int end = a + arm;
+                int overshoot = (arm > max_len) ? arm - max_len : 0;
+                int left, right, gap;
+
+                if (odd) {
+                    left = k - end;
+                    right = k + end;
+                    gap = 2 * a + 1;
+                }
+                else {
+                    left = k - end + 1;
+                    right = k + end;
+                    gap = 2 * a;
+                }
+
+                palindromes->push_back(tuple<int, int, int>(left + overshoot, right - overshoot, gap));
+            }
+        }
+    }
+}
+
+// Compressed index of S answering Longest Common Extensions, without full-size SA, invSA or LCP arrays
+//
+// EXTRA INFO:
+// - The inverse suffix array is sampled within a compressed suffix array (wavelet tree of the BWT), the LCP array is held in
+//   directly addressable codes, and minima of the LCP array come from a succinct RMQ over it
+// - Ranks include the 0 sdsl appends to S, which sorts first
+struct CompressedIndex {
+    csa_wt<> csa;
+    lcp_dac<> lcp;
+    rmq_succinct_sct<> rmq;
+};
+
+// Builds the compressed index of S, using files in a scratch directory while building
+//
+// INPUT:
+// - Compressed index (empty)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Scratch directory
+void buildCompressedIndex(CompressedIndex* index, unsigned char* S, INT S_n, string scratch_dir) {
+    PhaseScope scope(PHASE_COMPRESSED_INDEX);
+    cache_config config(false, scratch_dir);
+
+    cacheText(S, S_n, config);
+    construct(index->csa, cache_file_name(conf::KEY_TEXT, config), config, 1);
+    construct_lcp_semi_extern_PHI(config);
+
+    index->lcp = lcp_dac<>(config);
+    index->rmq = rmq_succinct_sct<>(&index->lcp);
+
+    util::delete_all_files(config.file_map);
+}
+
+// Returns the number of bytes taken by the compressed index of S
+//
+// INPUT:
+// - Compressed index (filled)
+uint64_t compressedIndexSize(CompressedIndex* index) {
+    return size_in_bytes(index->csa) + size_in_bytes(index->lcp) + size_in_bytes(index->rmq);
+}
+
+// Returns the Longest Common Extension between position i and j (order of i, j input does not matter), using a compressed index
+//
+// EXTRA INFO:
+// - Up to DIRECT_LCE_LIMIT characters are compared directly first, as each inverse suffix array lookup walks the compressed suffix
+//   array back to a sample
+//
+// INPUT:
+// - Text
+// - Indexes i and j
+// - Text length
+// - Compressed index of the text (filled)
+unsigned int LCE(unsigned char* text, INT i, INT j, INT n, CompressedIndex* index) {
+    if (i == j) {
+        return n - i;
+    }
+
+    unsigned int l = 0;
+
+    while (text[i + l] == text[j + l]) {
+        l++;
+
+        if (l == DIRECT_LCE_LIMIT) {
+            INT rank_i = index->csa.isa[i + l];
+            INT rank_j = index->csa.isa[j + l];
+
+            if (rank_i > rank_j) {
+                swap(rank_i, rank_j);
+            }
+
+            return l + index->lcp[index->rmq(rank_i + 1, rank_j)];
+        }
+    }
+
+    return l;
+}
+
+// Finds all inverted repeats (palindromes) centred at one parity of centre, for a fixed number of allowed mismatches, using a compressed index
+//
+// EXTRA INFO:
+// - Produces the same palindromes as addPalindromesFixed
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Text length
+// - Compressed index of S (filled)
+// - Minimum length, maximum length and maximum gap of palindromes
+// - Range of centres to check (k_from <= k < k_to)
+template<int K, bool ODD>
+void addPalindromesCompressed(P_buffer* palindromes, unsigned char* S, int S_n, int n, CompressedIndex* index, int min_len, int max_len, int max_gap, int k_from, int k_to) {
+    int initial_gap;
+
+    if (max_gap % 2 == 1) {
+        initial_gap = (max_gap - 1) / 2;
+    }
+    else {
+        initial_gap = ODD ? (max_gap - 2) / 2 : max_gap / 2;
+    }
+
+    int last_centre = min(ODD ? n - 1 : n - 2, k_to - 1);
+
+    for (int k = k_from; k <= last_centre; k++) {
+        INT i = k + 1;
+        INT j = ODD ? 2 * n + 1 - k : 2 * n - k;
+
+        CentreMismatches<K, ODD> centre(palindromes, k, min_len, max_len, initial_gap);
+        int real_lce = 0;
+
+        while (true) {
+            real_lce = real_lce + LCE(S, i + real_lce, j + real_lce, S_n, index);
+
+            if ( i + real_lce >= (S_n / 2) or j + real_lce >= S_n ) {
+                break;
+            }
+
+            if ( !MatchMatrix::match(S[i + real_lce], S[j + real_lce]) and !centre.add(real_lce) ) {
+                break;
+            }
+
+            real_lce++;
+        }
+
+        centre.finish();
+    }
+}
+
+// Finds all inverted repeats (palindromes) with given parameters using a compressed index of S, and adds them to an output buffer
+//
+// EXTRA INFO:
+// - Builds no SA, invSA or LCP arrays, so takes a fraction of the memory of the other index-based engines at some cost in speed
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Text length
+// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap),
+//   with at most 8 allowed mismatches
+// - Scratch directory for building the index
+// - Number of threads to scan centres with
+void addPalindromesCompressed(P_buffer* palindromes, unsigned char* S, int S_n, int n, tuple<int, int, int, int> params, string scratch_dir, int threads) {
+    int min_len = get<0>(params);
+    int max_len = get<1>(params);
+    int mismatches = get<2>(params);
+    int max_gap = get<3>(params);
+
+    CompressedIndex index;
+    buildCompressedIndex(&index, S, S_n, scratch_dir);
+
+    uint64_t bytes = compressedIndexSize(&index);
+    cout << "Compressed index: " << bytes << " bytes (" << (double) bytes / n << " per base)." << endl;
+
+    #define COMPRESSED_CASE(K) case K: \
+        addPalindromesCompressed<K, true>(buffer, S, S_n, n, &index, min_len, max_len, max_gap, k_from, k_to); \
+        addPalindromesCompressed<K, false>(buffer, S, S_n, n, &index, min_len, max_len, max_gap, k_from, k_to); \
+        break;
+
+    scanCentres(palindromes, 0, n, threads, [&](P_buffer* buffer, int k_from, int k_to) {
+        switch (mismatches) {
+            COMPRESSED_CASE(0)
+            COMPRESSED_CASE(1)
+            COMPRESSED_CASE(2)
+            COMPRESSED_CASE(3)
+            COMPRESSED_CASE(4)
+            COMPRESSED_CASE(5)
+            COMPRESSED_CASE(6)
+            COMPRESSED_CASE(7)
+            COMPRESSED_CASE(8)
+        }
+    });
+
+    #undef COMPRESSED_CASE
+}
+
+// Finds all inverted repeats (palindromes) with given parameters and adds them to an output buffer
+//
+// EXTRA INFO:
+// - ENGINE_EXACT uses a version dedicated to 0 allowed mismatches
+// - ENGINE_FIXED uses a version specialised at compile time for 0 to 8 allowed mismatches (falling back to the generic version otherwise)
+// - ENGINE_GENERIC uses the generic version
+// - ENGINE_SEED first marks the centres sharing a seed with the reverse complement, then verifies only those with the first of the above that applies
+// - ENGINE_AUTO seeds when few centres are expected to be marked, and otherwise picks the first of the above that applies for every centre
+//
+// INPUT:
+// - Output buffer of integer 3-tuples to store palindromes in form (left_index, right_index, gap)
+// - S = text + '$' + complement(reverse(text) + '#'
+// - Length of S
+// - Text length
+// - Inverse Suffix Array
+// - Longest Common Prefix Array (LCP)
+// - Data structure (filled) with preprocessed values to perform Range Minimum Queries (Type 1: 'A', Type 2: 'rmq')
+// - Engine to use
+// - Tuple of parameters for palindromes to be found (minimum_length, maximum_length, maximum_allowed_number_of_mismatches, maximum_gap)
+// - Whether the text holds only 'a', 'c', 'g', 't', letting the exact and fixed versions take a faster path
+// - Number of threads to scan centres with
+// - First centre to scan
+// - Centre after the last to scan
+#ifdef _USE_NLOGN_RMQ
+// Using Type 1 RMQs
+void addPalindromes(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, INT * LCP, INT * A, Engine engine, tuple<int, int, int, int> params, bool pure_bases, int threads, int centres_from, int centres_to) {
+    #define RMQ_DATA A
+#else
+// Using Type 2 RMQs
+void addPalindromes(P_buffer* palindromes, unsigned char* S, int S_n, int n, INT * invSA, int_vector<> &LCP, rmq_succinct_sct<> &rmq, Engine engine, tuple<int, int, int, int> params, bool pure_bases, int threads, int centres_from, int centres_to) {
+    #define RMQ_DATA rmq
+#endif
+    // Centres to verify, or NULL to check every centre
+    bit_vector seed_centres;
+    bit_vector* centres = NULL;
+
+    int min_len = get<0>(params);
+    int max_len = get<1>(params);
+    int mismatches = get<2>(params);
+    int max_gap = get<3>(params);
+
+    if (engine == ENGINE_AUTO and seedDensity(S, n, params) <= SEED_DENSITY_LIMIT) {
+        engine = ENGINE_SEED;
+    }
+
+    if (engine == ENGINE_SEED) {
+        seed_centres = bit_vector(2 * n, 0);
+        seedCentres(&seed_centres, S, n, params);
+        centres = &seed_centres;
+        engine = ENGINE_AUTO;
+    }
+
+    if (engine == ENGINE_AUTO) {
+        engine = (mismatches == 0) ? ENGINE_EXACT : ENGINE_FIXED;
+    }
+
+    // Scans are only counted by versions of the engines compiled to count them, so scans not counted cost nothing more
+    #define EXACT_CASE(PURE, STATS) \
+        if (pure_bases == PURE and scan_counting == STATS) { \
+            addPalindromesExact<true, PURE, STATS>(buffer, S, S_n, n, invSA, LCP, RMQ_DATA, min_len, max_len, max_gap, centres, k_from, k_to); \
+            addPalindromesExact<false, PURE, STATS>(buffer, S, S_n, n, invSA, LCP, RMQ_DATA, min_len, max_len, max_gap, centres, k_from, k_to); \
+        }
+
+    if (engine == ENGINE_EXACT and mismatches == 0) {
+        scanCentres(palindromes, centres_from, centres_to, threads, [&](P_buffer* buffer, int k_from, int k_to) {
+            EXACT_CASE(true, false)
+            EXACT_CASE(false, false)
+            EXACT_CASE(true, true)
+            EXACT_CASE(false, true)
+        });
+        return;
+    }
+
+    #undef EXACT_CASE
+
+    #define FIXED_CASE(K) \
+        case K: \
+            if (scan_counting) addPalindromesFixed<K, true>(buffer, S, S_n, n, invSA, LCP, RMQ_DATA, min_len, max_len, max_gap, centres, pure_bases, k_from, k_to); \
+            else addPalindromesFixed<K, false>(buffer, S, S_n, n, invSA, LCP, RMQ_DATA, min_len, max_len, max_gap, centres, pure_bases, k_from, k_to); \
+            break;
+
+    if (engine == ENGINE_FIXED and mismatches <= 8) {
+        scanCentres(palindromes, centres_from, centres_to, threads, [&](P_buffer* buffer, int k_from, int k_to) {
+            switch (mismatches) {
+                FIXED_CASE(0)
+                FIXED_CASE(1)
+                FIXED_CASE(2)
+                FIXED_CASE(3)
+                FIXED_CASE(4)
+                FIXED_CASE(5)
+                FIXED_CASE(6)
+                FIXED_CASE(7)
+                FIXED_CASE(8)
+            }
+        });
+        return;
+    }
+
+    #undef FIXED_CASE
+
+    scanCentres(palindromes, centres_from, centres_to, threads, [&](P_buffer* buffer, int k_from, int k_to) {
+        if (scan_counting) {
+            addPalindromesGeneric<true>(buffer, S, S_n, n, invSA, LCP, RMQ_DATA, params, centres, k_from, k_to);
+        } else {
+            addPalindromesGeneric<false>(buffer, S, S_n, n, invSA, LCP, RMQ_DATA, params, centres, k_from, k_to);
+        }
+    });
+
+    #undef RMQ_DATA
+}
+
+
+////////////////////////////////
+//  MEMORY PLANNER FUNCTIONS  //
+////////////////////////////////
+
+// Memory taken by the program itself, in bytes
+#define PLAN_BASE_MEMORY (4L * 1024 * 1024)
+
+// Bytes of output per palindrome, besides the characters of its arms and the line matching them
+#define PLAN_OUTPUT_BYTES 60
+
+// Costs of building a suffix array index, per character of S, in the units of DIAGONAL_INDEX_COST (measured on random sequences
+// of 1,000,000 and 5,000,000 bases; searching costs about the same however the index is held)
+#define PLAN_SPARSE_COST 400
+#define PLAN_SUCCINCT_COST 175
+#define PLAN_SPARSE_DISK_COST 1350
+#define PLAN_SUCCINCT_DISK_COST 500
+
+// Smallest number of centres in a window, as a multiple of the bases palindromes may reach on either side of their centre
+#define PLAN_MIN_WINDOW 16
+
+// Ways of holding the index of a sequence, which the planner picks from to fit the memory given
+enum Plan { PLAN_NONE, PLAN_MEMORY, PLAN_WINDOWED, PLAN_COMPRESSED, PLAN_DISK, PLAN_TREE };
+
+// Plan picked for a sequence, with the centres in each window, and predicted peak memory, memory of the index and cost
+struct PlanChoice {
+    Plan plan;
+    long int window;
+    long int memory;
+    long int index;
+    double cost;
+};
+
+// Returns the memory taken by the index of a text held in memory, in bytes
+//
+// INPUT:
+// - Text length
+// - Whether RMQs use a sparse table (Type 1), rather than a succinct structure (Type 2)
+long int inMemoryIndexBytes(long int n, bool sparse) {
+    long int S_n = 2 * n + 2;
+
+    if (sparse) {
+        return (3 + flog2(S_n)) * S_n * sizeof(INT);
+    }
+
+    // SA and invSA, with LCP and the RMQ data held by sdsl
+    return 2 * S_n * sizeof(INT) + S_n * (flog2(S_n) + 1) / 8 + S_n / 4;
+}
+
+// Returns the memory taken while searching a text with a plan (S and the index, but not the sequence), in bytes
+//
+// INPUT:
+// - Plan
+// - Text length
+long int planIndexMemory(Plan plan, long int n) {
+    long int S_n = 2 * n + 2;
+
+    #ifdef _USE_NLOGN_RMQ
+        bool sparse = true;
+    #else
+        bool sparse = false;
+    #endif
+
+    switch (plan) {
+        case PLAN_NONE:
+            return S_n + n;
+        case PLAN_MEMORY:
+        case PLAN_WINDOWED:
+            return S_n + inMemoryIndexBytes(n, sparse);
+        case PLAN_COMPRESSED:
+            return S_n + 9 * S_n / 2;
+        case PLAN_DISK:
+            return S_n + (sparse ? 2 * S_n : S_n * (flog2(S_n) + 1) / 8 + S_n / 4);
+        case PLAN_TREE:
+            return S_n + 16 * S_n;
+    }
+
+    return 0;
+}
+
+// Returns the cost of building the index of a text with a plan, in the units of DIAGONAL_INDEX_COST
+//
+// INPUT:
+// - Plan
+// - Text length
+double planCost(Plan plan, long int n) {
+    double S_n = 2.0 * n + 2;
+
+    #ifdef _USE_NLOGN_RMQ
+        double memory_cost = PLAN_SPARSE_COST, disk_cost = PLAN_SPARSE_DISK_COST;
+    #else
+        double memory_cost = PLAN_SUCCINCT_COST, disk_cost = PLAN_SUCCINCT_DISK_COST;
+    #endif
+
+    switch (plan) {
+        case PLAN_MEMORY:
+        case PLAN_WINDOWED:
+            return S_n * memory_cost;
+        case PLAN_DISK:
+            return S_n * disk_cost;
+        default:
+            return 0.0;
+    }
+}
+
+// Picks the plan of least cost for searching a sequence that fits in the memory available, or the one taking least memory if
+// none fits
+//
+// EXTRA INFO:
+// - Memory is that held by the program and its output, of the sequence as read and the part of it searched, and of the index
+//   searched; the next index is built while one is searched, so the index held before (of the previous sequence or window) is
+//   counted too
+// - Windowed plans take the largest windows that fit, of at least PLAN_MIN_WINDOW times the reach of palindromes; each window
+//   indexes its centres and the bases their palindromes may reach, so smaller windows cost more
+//
+// INPUT:
+// - Plans to consider
+// - Memory held besides sequences and indexes, in bytes
+// - Length of the sequence as read
+// - Number of centres searched
+// - Length of the text holding them and the bases their palindromes may reach
+// - Largest distance from a centre to the bases of palindromes found there
+// - Memory of the index held before, in bytes
+// - Memory available, in bytes
+PlanChoice planSearch(vector<Plan> plans, long int held, long int length, long int centres, long int n, long int reach, long int previous, long int available) {
+    long int base = held + length + n;
+    vector<PlanChoice> choices;
+
+    for (Plan plan : plans) {
+        PlanChoice choice;
+        choice.plan = plan;
+        choice.window = centres;
+
+        if (plan == PLAN_WINDOWED) {
+            long int least = PLAN_MIN_WINDOW * reach;
+
+            if (least >= centres) {
+                continue;
+            }
+
+            // Two windows are held at once; find the largest window that fits, or take the smallest
+            auto windowMemory = [&](long int window) {
+                long int index = planIndexMemory(plan, min(n, window + 2 * reach));
+                return base + max(previous, index) + index;
+            };
+
+            long int low = least, high = centres - 1;
+
+            while (low < high) {
+                long int middle = low + (high - low + 1) / 2;
+
+                if (windowMemory(middle) <= available) {
+                    low = middle;
+                } else {
+                    high = middle - 1;
+                }
+            }
+
+            long int window_n = min(n, low + 2 * reach);
+
+            choice.window = low;
+            choice.index = planIndexMemory(plan, window_n);
+            choice.memory = windowMemory(low);
+            choice.cost = planCost(plan, window_n) * ((centres + low - 1) / low);
+        } else {
+            choice.index = planIndexMemory(plan, n);
+            choice.memory = base + previous + choice.index;
+            choice.cost = planCost(plan, n);
+        }
+
+        choices.push_back(choice);
+    }
+
+    PlanChoice best = choices.front();
+
+    for (PlanChoice& choice : choices) {
+        bool fits = (choice.memory <= available);
+        bool best_fits = (best.memory <= available);
+
+        if ((fits and !best_fits) or (fits and best_fits and choice.cost < best.cost) or (!fits and !best_fits and choice.memory < best.memory)) {
+            best = choice;
+        }
+    }
+
+    return best;
+}
+
+
+////////////////////////////
+//  CHECKPOINT FUNCTIONS  //
+////////////////////////////
+
+// Writes a checkpoint file in one step, returning whether it succeeded
+//
+// EXTRA INFO:
+// - The text is written to 'filename.tmp', synced to disk and renamed over the file, so a run stopped at any point leaves either
+//   the previous checkpoint or the new one
+//
+// INPUT:
+// - Filename
+// - Lines of the checkpoint, each 'key: value'
+bool writeCheckpoint(string filename, const string& text) {
+    string temporary = filename + ".tmp";
+    FILE * f = fopen(temporary.c_str(), "wb");
+
+    if (f == NULL) {
+        return false;
+    }
+
+    bool written = fwrite(text.data(), 1, text.size(), f) == text.size() and fflush(f) == 0 and fsync(fileno(f)) == 0;
+
+    return (fclose(f) == 0) and written and rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+// Reads the lines of a checkpoint file written by writeCheckpoint, returning false if there is none
+//
+// INPUT:
+// - Filename
+// - Map to fill from each line 'key: value'
+bool readCheckpoint(string filename, map<string, string>* values) {
+    ifstream file(filename);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    for (string line; getline(file, line); ) {
+        size_t split = line.find(": ");
+
+        if (split != string::npos) {
+            (*values)[line.substr(0, split)] = line.substr(split + 2);
+        }
+    }
+
+    return true;
+}
+
+
+////////////////////////
+//  OUTPUT FUNCTIONS  //
+////////////////////////
+
+// Number of palindromes formatted together as one block of output
+#define OUTPUT_BLOCK 4096
+
+// Compresses text as a complete gzip member
+//
+// EXTRA INFO:
+// - A file of gzip members one after another decompresses to the concatenation of their texts
+//
+// INPUT:
+// - Text to compress
+string gzipBlock(const string& text) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    // Window bits above 15 ask for a gzip header and trailer
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+    string compressed(deflateBound(&stream, text.size()), '\0');
+
+    stream.next_in = (Bytef *) text.data();
+    stream.avail_in = text.size();
+    stream.next_out = (Bytef *) &compressed[0];
+    stream.avail_out = compressed.size();
+
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return compressed;
+}
+
+// Output file written by a thread of its own, from blocks of text formatted (and compressed) by worker threads
+//
+// EXTRA INFO:
+// - Blocks are written in the order they were added, whichever worker finishes first
+// - Files named '*.gz' are compressed with gzip, each block as a gzip member of its own
+// - Adding a block only waits when too many are pending, which bounds the memory held by blocks not yet written
+// - A block may carry a mark, the checkpoint of a search once all blocks up to it are written; when checkpoints are kept, the
+//   file is synced to disk after such a block and the mark written as the checkpoint, with the number of bytes written, at most
+//   once per interval
+class OutputSink {
+    FILE * file = NULL;
+    bool gzip = false;
+    mutex lock;
+    condition_variable changed;
+    list< pair<long int, function<string()> > > jobs;
+    map<long int, string> done;
+    map<long int, string> marks;
+    long int added = 0;
+    long int written = 0;
+    long int window = 0;
+    bool closed = false;
+    vector<thread> workers;
+    thread writer;
+
+    // Bytes written to the file, and where and how often checkpoints are written
+    long int bytes = 0;
+    string checkpoint_file;
+    double checkpoint_interval = 0;
+    chrono::steady_clock::time_point checkpointed;
+
+    // Formats (and compresses) blocks until the sink is closed
+    void work() {
+        traceThread("output");
+        unique_lock<mutex> guard(lock);
+
+        while (true) {
+            changed.wait(guard, [&]() { return !jobs.empty() or closed; });
+
+            if (jobs.empty()) {
+                return;
+            }
+
+            pair<long int, function<string()> > job = jobs.front();
+            jobs.pop_front();
+            guard.unlock();
+
+            string text;
+
+            {
+                PhaseScope scope(PHASE_FORMAT);
+                text = job.second();
+            }
+
+            if (gzip and !text.empty()) {
+                PhaseScope scope(PHASE_COMPRESS);
+                text = gzipBlock(text);
+            }
+
+            guard.lock();
+            done[job.first].swap(text);
+            changed.notify_all();
+        }
+    }
+
+    // Writes blocks in order as they are finished, until the sink is closed and all are written
+    void write() {
+        traceThread("writer");
+        unique_lock<mutex> guard(lock);
+
+        while (true) {
+            changed.wait(guard, [&]() { return done.count(written) > 0 or (closed and written == added); });
+
+            if (done.count(written) == 0) {
+                return;
+            }
+
+            string text, mark;
+            text.swap(done[written]);
+            done.erase(written);
+
+            if (marks.count(written) > 0) {
+                mark.swap(marks[written]);
+                marks.erase(written);
+            }
+
+            guard.unlock();
+
+            {
+                PhaseScope scope(PHASE_WRITE);
+
+                fwrite(text.data(), 1, text.size(), file);
+                bytes += text.size();
+
+                if (!mark.empty() and checkpoint_file != "" and chrono::steady_clock::now() - checkpointed >= chrono::duration<double>(checkpoint_interval)) {
+                    bool synced = fflush(file) == 0 and fsync(fileno(file)) == 0;
+
+                    if (!synced or !writeCheckpoint(checkpoint_file, mark + "output_bytes: " + to_string(bytes) + "\n")) {
+                        fprintf(stderr, " Error: Cannot write checkpoint '%s'.\n", checkpoint_file.c_str() );
+                        exit(EXIT_FAILURE);
+                    }
+
+                    checkpointed = chrono::steady_clock::now();
+                }
+            }
+
+            guard.lock();
+            written++;
+            changed.notify_all();
+        }
+    }
+
+public:
+    // Opens the output file and starts the threads writing to it, returning whether the file could be opened
+    //
+    // INPUT:
+    // - Filename (compressed with gzip if it ends in '.gz')
+    // - Number of worker threads
+    // - Number of bytes already written to the file to keep, writing after them (0 to write a new file)
+    bool open(string filename, int threads, long int keep) {
+        gzip = (filename.size() > 3 and filename.compare(filename.size() - 3, 3, ".gz") == 0);
+
+        if (keep > 0) {
+            file = (truncate(filename.c_str(), keep) == 0) ? fopen(filename.c_str(), "ab") : NULL;
+            bytes = keep;
+        } else {
+            file = fopen(filename.c_str(), "wb");
+        }
+
+        if (file == NULL) {
+            return false;
+        }
+
+        window = 4 * threads + 4;
+
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread(&OutputSink::work, this));
+        }
+
+        writer = thread(&OutputSink::write, this);
+
+        return true;
+    }
+
+    // Writes checkpoints from the marks of blocks
+    //
+    // INPUT:
+    // - Checkpoint filename
+    // - Least time between checkpoints, in seconds
+    void checkpoint(string filename, double interval) {
+        lock_guard<mutex> guard(lock);
+        checkpoint_file = filename;
+        checkpoint_interval = interval;
+        checkpointed = chrono::steady_clock::now();
+    }
+
+    // Adds a block of output, given as a function formatting it, with an optional checkpoint mark
+    void add(function<string()> format, string mark = "") {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&]() { return added - written < window; });
+
+        if (!mark.empty()) {
+            marks[added].swap(mark);
+        }
+
+        jobs.push_back(make_pair(added++, format));
+        changed.notify_all();
+    }
+
+    // Waits for all blocks to be written, then closes the output file
+    void close() {
+        {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+            changed.notify_all();
+        }
+
+        for (thread& worker : workers) {
+            worker.join();
+        }
+
+        writer.join();
+        fclose(file);
+    }
+};
+
+
+//////////////////////
+//  SEARCH RECORDS  //
+//////////////////////
+
+// A sequence passing through the stages of the search, with its index and the palindromes found in it
+struct Record {
+    string name;
+    long int number;
+    bool pure_bases;
+
+    // For a shard, seq is the part of the sequence starting at offset, holding the centres shard_from <= c < shard_to and the
+    // bases their palindromes may reach; the whole sequence has length 'length'
+    long int length;
+    long int offset = 0;
+    long int shard_from;
+    long int shard_to;
+    shared_ptr< vector<unsigned char> > seq;
+
+    // How the index is held, and the window of centres window_from <= c < window_to searched in this record (of windows in
+    // total): its text is the n characters of the sequence from text_offset, holding the bases their palindromes may reach
+    Plan plan = PLAN_MEMORY;
+    int window = 0;
+    int windows = 1;
+    long int window_from;
+    long int window_to;
+    long int text_offset;
+    long int n;
+
+    // S = seq + '$' + complement(reverse(seq) + '#', and the engine searching it
+    int S_n;
+    vector<unsigned char> S;
+    Engine engine;
+
+    // Index of S, for the engines searching a suffix array (held in an arena, or mapped from stored or temporary files)
+    bool mapped = false;
+    bool external = false;
+    IndexArena arena;
+    INT * SA = NULL;
+    INT * invSA = NULL;
+
+    #ifdef _USE_NLOGN_RMQ
+        INT * LCP = NULL;
+        INT * A = NULL;
+    #else
+        int_vector<> LCP;
+        rmq_succinct_sct<> rmq;
+    #endif
+
+    // Palindromes found, passed on to a store holding them in sorted order, shared by the windows of the sequence
+    P_buffer palindromes;
+    shared_ptr<ResultStore> results;
+
+    // The first record of a sequence opens its store, and is passed to the output, which releases it once all are written
+    bool first = true;
+
+    // For a search resumed from a checkpoint, the centre it resumes from, with the header and all palindromes starting before it
+    // already written
+    bool resumed = false;
+    int resume_centre = 0;
+};
+
+
+//////////////////////
+//  MAIN EXECUTION  //
+//////////////////////
+
+int main(int argc, char* argv[]) {
+
+    ///////////////////////
+    //  REQUEST OPTIONS  //
+    ///////////////////////
+
+    // Default parameters
+    string input_file = "input.fasta";
+    string seq_name = "seq0";
+    int min_len = 10;
+    int max_len = 100;
+    int max_gap = 100;
+    int mismatches = 0;
+    string output_file = "IUPACpal.out";
+    string engine_name = "auto";
+    int threads = 1;
+    long int memory_limit = 0;
+    long int results_memory = 1024;
+    string scratch_dir = ".";
+    string index_prefix = "";
+    bool hugepages = false;
+    string numa_mode = "off";
+    string shard = "1/1";
+    string checkpoint_file = "";
+    int checkpoint_interval = 300;
+    bool resume = false;
+    long int max_memory = 0;
+    string profile = "";
+    bool stats = false;
+    bool perf_counters = false;
+    string trace = "";
+
+    // Options without a single character flag
+    enum { OPT_MEMORY_LIMIT = 256, OPT_RESULTS_MEMORY, OPT_SCRATCH_DIR, OPT_INDEX, OPT_HUGEPAGES, OPT_NUMA, OPT_SHARD, OPT_CHECKPOINT,
+           OPT_CHECKPOINT_INTERVAL, OPT_RESUME, OPT_MAX_MEMORY, OPT_PROFILE, OPT_STATS, OPT_PERF_COUNTERS,
+           OPT_TRACE };
+
+    static struct option long_options[] = {
+        { "memory-limit", required_argument, NULL, OPT_MEMORY_LIMIT },
+        { "results-memory", required_argument, NULL, OPT_RESULTS_MEMORY },
+        { "scratch-dir", required_argument, NULL, OPT_SCRATCH_DIR },
+        { "index", required_argument, NULL, OPT_INDEX },
+        { "hugepages", no_argument, NULL, OPT_HUGEPAGES },
+        { "numa", required_argument, NULL, OPT_NUMA },
+        { "shard", required_argument, NULL, OPT_SHARD },
+        { "checkpoint", required_argument, NULL, OPT_CHECKPOINT },
+        { "checkpoint-interval", required_argument, NULL, OPT_CHECKPOINT_INTERVAL },
+        { "resume", no_argument, NULL, OPT_RESUME },
+        { "max-memory", required_argument, NULL, OPT_MAX_MEMORY },
+        { "profile", required_argument, NULL, OPT_PROFILE },
+        { "stats", no_argument, NULL, OPT_STATS },
+        { "perf-counters", no_argument, NULL, OPT_PERF_COUNTERS },
+        { "trace", required_argument, NULL, OPT_TRACE },
+        { NULL, 0, NULL, 0 }
+    };
+
+    // Parse command line arguments
+    int c;
+    while( ( c = getopt_long (argc, argv, "f:s:m:M:g:x:o:e:t:", long_options, NULL) ) != -1 )
+    {
+        switch(c)
+        {
+            case 'f':
+                if(optarg) input_file = optarg;
+                break;
+            case 's':
+                if(optarg) seq_name = optarg;
+                break;
+            case 'm':
+                if(optarg) min_len = std::atoi(optarg);
+                break;
+            case 'M':
+                if(optarg) max_len = std::atoi(optarg);
+                break;
+            case 'g':
+                if(optarg) max_gap = std::atoi(optarg);
+                break;
+            case 'x':
+                if(optarg) mismatches = std::atoi(optarg);
+                break;
+            case 'o':
+                if(optarg) output_file = optarg;
+                break;
+            case 'e':
+                if(optarg) engine_name = optarg;
+                break;
+            case 't':
+                if(optarg) threads = std::atoi(optarg);
+                break;
+            case OPT_MEMORY_LIMIT:
+                if(optarg) memory_limit = std::atol(optarg);
+                break;
+            case OPT_RESULTS_MEMORY:
+                if(optarg) results_memory = std::atol(optarg);
+                break;
+            case OPT_SCRATCH_DIR:
+                if(optarg) scratch_dir = optarg;
+                break;
+            case OPT_INDEX:
+                if(optarg) index_prefix = optarg;
+                break;
+            case OPT_HUGEPAGES:
+                hugepages = true;
+                break;
+            case OPT_NUMA:
+                if(optarg) numa_mode = optarg;
+                break;
+            case OPT_SHARD:
+                if(optarg) shard = optarg;
+                break;
+            case OPT_CHECKPOINT:
+                if(optarg) checkpoint_file = optarg;
+                break;
+            case OPT_CHECKPOINT_INTERVAL:
+                if(optarg) checkpoint_interval = std::atoi(optarg);
+                break;
+            case OPT_RESUME:
+                resume = true;
+                break;
+            case OPT_MAX_MEMORY:
+                if(optarg) max_memory = std::atol(optarg);
+                break;
+            case OPT_PROFILE:
+                if(optarg) profile = optarg;
+                break;
+            case OPT_STATS:
+                stats = true;
+                break;
+            case OPT_PERF_COUNTERS:
+                perf_counters = true;
+                break;
+            case OPT_TRACE:
+                if(optarg) trace = optarg;
+                break;
+        }
+    }
+;
+    ///////////////////////
+    //  VERIFY OPTIONS   //
+    ///////////////////////
+
+    // Check input file exists, exit if it does not
+    if (!exist(input_file.c_str())) {  usage(); cout << "Error: File '" + input_file + "' not found." << endl; return -1; }
+
+    if (perf_counters and profile == "") { usage(); cout << "Error: perf_counters requires a profile." << endl; return -1; }
+
+    // Phases are profiled from the first reading of the input on
+    chrono::steady_clock::time_point profile_start = chrono::steady_clock::now();
+    bool perf_started = false;
+
+    if (profile != "") {
+        startProfile();
+    }
+
+    if (perf_counters) {
+        perf_started = startPerfCounters();
+    }
+
+    scan_counting = stats;
+
+    if (trace != "") {
+        startTrace();
+    }
+
+    // Names of the sequences to search, separated by commas
+    vector<string> seq_names;
+    stringstream seq_list(seq_name);
+
+    for (string name; getline(seq_list, name, ','); ) {
+        seq_names.push_back(name);
+    }
+
+    if (seq_names.empty()) {
+        seq_names.push_back(seq_name);
+    }
+
+    // Find the length of each sequence, so that all are checked before any is searched
+    map<string, long int> seq_lengths;
+
+    {
+        FastaReader reader;
+        reader.input.open(input_file);
+        set<string> names(seq_names.begin(), seq_names.end());
+        string name;
+        long int length;
+
+        while (nextRecord(&reader, &names, &name, NULL, &length)) {
+            seq_lengths[name] = length;
+        }
+    }
+
+    // Check if each sequence name was found, exit if not
+    for (string name : seq_names) {
+        if (seq_lengths.count(name) == 0) {  usage(); cout << "Error: Sequence '" + name + "' not found in file '" + input_file + "'." << endl; return -1; }
+    }
+
+    // Verify arguments are valid with respect to individual limits
+    if (min_len < 2) { usage(); cout << "Error: min_len must not be less than 2." << endl; return -1; }
+    if (min_len > INT_MAX) { usage(); cout << "Error: min_len must not greater than " << INT_MAX << "." << endl; return -1; }
+    if (max_len < 0) { usage(); cout << "Error: max_len must not be a negative value." << endl; return -1; }
+    if (max_len > INT_MAX) { usage(); cout << "Error: max_len must not greater than " << INT_MAX << "." << endl; return -1; }
+    if (max_gap < 0) { usage(); cout << "Error: max_gap must not be a negative value." << endl; return -1; }
+    if (max_gap > INT_MAX) { usage(); cout << "Error: max_gap must not greater than " << INT_MAX << "." << endl; return -1; }
+    if (mismatches < 0) { usage(); cout << "Error: mismatches must not be a negative value." << endl; return -1; }
+    if (mismatches > INT_MAX) { usage(); cout << "Error: mismatches must not greater than " << INT_MAX << "." << endl; return -1; }
+    if (threads < 1) { usage(); cout << "Error: threads must be at least 1." << endl; return -1; }
+    if (memory_limit < 0) { usage(); cout << "Error: memory_limit must not be a negative value." << endl; return -1; }
+    if (results_memory < 0) { usage(); cout << "Error: results_memory must not be a negative value." << endl; return -1; }
+    if (max_memory < 0) { usage(); cout << "Error: max_memory must not be a negative value." << endl; return -1; }
+    if (!exist(scratch_dir.c_str())) { usage(); cout << "Error: Directory '" + scratch_dir + "' not found." << endl; return -1; }
+    if (profile != "" and profile != "stderr" and !writeProfile(profile, 0.0)) { usage(); cout << "Error: Cannot write profile '" + profile + "'." << endl; return -1; }
+    if (trace != "" and !writeTrace(trace)) { usage(); cout << "Error: Cannot write trace '" + trace + "'." << endl; return -1; }
+    if (numa_mode != "off" and numa_mode != "interleave" and numa_mode != "replicate") { usage(); cout << "Error: numa mode '" + numa_mode + "' is not known." << endl; return -1; }
+
+    // Verify shard is given as k/N with 1 <= k <= N
+    int shard_k = 0, shard_n = 0;
+    char shard_rest;
+    if (sscanf(shard.c_str(), "%d/%d%c", &shard_k, &shard_n, &shard_rest) != 2 or shard_n < 1 or shard_k < 1 or shard_k > shard_n) { usage(); cout << "Error: shard '" + shard + "' must be k/N with 1 <= k <= N." << endl; return -1; }
+
+    // Palindromes found at centre c start at most max_len + max_gap + mismatches before it, and end at most as far after it
+    long int reach = (long int) max_len + max_gap + mismatches + 1;
+
+    if (checkpoint_interval < 0) { usage(); cout << "Error: checkpoint_interval must not be a negative value." << endl; return -1; }
+    if (resume and checkpoint_file == "") { usage(); cout << "Error: resume requires a checkpoint file." << endl; return -1; }
+
+    // Parameters a checkpoint must share with a search resumed from it
+    vector< pair<string, string> > search = {
+        { "input_file", input_file }, { "seq_name", seq_name }, { "min_len", to_string(min_len) }, { "max_len", to_string(max_len) },
+        { "max_gap", to_string(max_gap) }, { "mismatches", to_string(mismatches) }, { "output_file", output_file }, { "shard", shard }
+    };
+
+    // The index is stored alongside the checkpoint unless stored elsewhere, so that a resumed search maps it rather than building it
+    bool checkpoint_index = (checkpoint_file != "" and index_prefix == "");
+
+    if (checkpoint_index) {
+        index_prefix = checkpoint_file;
+    }
+
+    // A resumed search skips the sequences written, and keeps the output written for the one it resumes within
+    map<string, string> checkpoint;
+    bool resumed = (resume and readCheckpoint(checkpoint_file, &checkpoint));
+    long int resume_records = 0;
+    long int resume_bytes = 0;
+
+    if (resumed) {
+        for (auto& value : search) {
+            if (checkpoint[value.first] != value.second) { usage(); cout << "Error: Checkpoint '" + checkpoint_file + "' is of a search with another " + value.first + "." << endl; return -1; }
+        }
+
+        resume_records = atol(checkpoint["sequences_written"].c_str());
+        resume_bytes = atol(checkpoint["output_bytes"].c_str());
+
+        struct stat output_stat;
+        if (stat(output_file.c_str(), &output_stat) != 0 or output_stat.st_size < resume_bytes) { usage(); cout << "Error: File '" + output_file + "' is shorter than checkpoint '" + checkpoint_file + "' records." << endl; return -1; }
+    }
+
+    // Verify arguments are valid with respect to each other, for every sequence
+    for (string name : seq_names) {
+        long int n = seq_lengths[name];
+
+        if (min_len >= n) { usage(); cout << "Error: min_len must be less than sequence length." << endl; return -1; }
+        if (max_len < min_len) { usage(); cout << "Error: max_len must not be less than min_len." << endl; return -1; }
+        if (max_gap >= n) { usage(); cout << "Error: max_gap must be less than sequence length." << endl; return -1; }
+        if (min_len >= n) { usage(); cout << "Error: min_len must be less than sequence length." << endl; return -1; }
+        if (mismatches >= n) { usage(); cout << "Error: mismatches must be less than sequence length." << endl; return -1; }
+        if (mismatches >= min_len) { usage(); cout << "Error: mismatches must be less than min_len." << endl; return -1; }
+    }
+
+    // Verify engine is known and applicable
+    Engine engine;
+    if (engine_name == "auto") { engine = ENGINE_AUTO; }
+    else if (engine_name == "generic") { engine = ENGINE_GENERIC; }
+    else if (engine_name == "fixed") { engine = ENGINE_FIXED; }
+    else if (engine_name == "exact") { engine = ENGINE_EXACT; }
+    else if (engine_name == "seed") { engine = ENGINE_SEED; }
+    else if (engine_name == "diagonal") { engine = ENGINE_DIAGONAL; }
+    else if (engine_name == "cst") { engine = ENGINE_CST; }
+    else if (engine_name == "compressed") { engine = ENGINE_COMPRESSED; }
+    else { usage(); cout << "Error: engine '" + engine_name + "' is not known." << endl; return -1; }
+
+    if (engine == ENGINE_EXACT and mismatches != 0) { usage(); cout << "Error: engine 'exact' requires mismatches to be 0." << endl; return -1; }
+    if (engine == ENGINE_CST and mismatches != 0) { usage(); cout << "Error: engine 'cst' requires mismatches to be 0." << endl; return -1; }
+    if (engine == ENGINE_DIAGONAL and mismatches > 8) { usage(); cout << "Error: engine 'diagonal' requires mismatches to be at most 8." << endl; return -1; }
+    if (engine == ENGINE_COMPRESSED and mismatches > 8) { usage(); cout << "Error: engine 'compressed' requires mismatches to be at most 8." << endl; return -1; }
+
+    // The diagonal engine builds no suffix array to store, so auto only picks it when no index is stored (a checkpoint needs no index
+    // to resume from)
+    bool auto_diagonal = (index_prefix == "" or checkpoint_index);
+
+    // With a limit on all memory, a quarter of it holds palindromes found, and the index is planned to fit in the rest
+    if (max_memory > 0 and (results_memory == 0 or results_memory > max_memory / 4)) {
+        results_memory = max(1L, max_memory / 4);
+    }
+
+    // Optionally display user given options
+    if (true) {
+    	cout << endl;
+        cout << "input_file: " << input_file << endl;
+        cout << "seq_name: " << seq_name << endl;
+
+        cout << "min_len: " << min_len << endl;
+        cout << "max_len: " << max_len << endl;
+        cout << "max_gap: " << max_gap << endl;
+        cout << "mismatches: " << mismatches << endl;
+        cout << "output_file: " << output_file << endl;
+        cout << "engine: " << engine_name << endl;
+        cout << "threads: " << threads << endl;
+        cout << "memory_limit: " << memory_limit << endl;
+        cout << "results_memory: " << results_memory << endl;
+        cout << "scratch_dir: " << scratch_dir << endl;
+        cout << "index: " << index_prefix << endl;
+        cout << "hugepages: " << (hugepages ? "yes" : "no") << endl;
+        cout << "numa: " << numa_mode << endl;
+        cout << "shard: " << shard << endl;
+        cout << "checkpoint: " << checkpoint_file << endl;
+        cout << "checkpoint_interval: " << checkpoint_interval << endl;
+        cout << "resume: " << (resume ? "yes" : "no") << endl;
+        cout << "max_memory: " << max_memory << endl;
+        cout << "profile: " << profile << endl;
+        cout << "stats: " << (stats ? "yes" : "no") << endl;
+        cout << "perf_counters: " << (perf_counters ? "yes" : "no") << endl;
+        cout << "trace: " << trace << endl;
+        cout << endl;
+    }
+
+    // The kernel may allow only some events, or none
+    if (perf_counters and !perf_started) {
+        cout << "Performance counters cannot be opened (" << perf_error << "), so are left out of the profile." << endl;
+    } else if (perf_counters and perf_error != "") {
+        cout << "Some performance counters cannot be opened (" << perf_error << ")." << endl;
+    }
+
+    if (resumed) {
+        cout << "Resuming from checkpoint '" << checkpoint_file << "' after " << resume_records << " sequences";
+        if (checkpoint.count("resume_centre") > 0) cout << ", within '" << checkpoint["sequence_name"] << "' from centre " << checkpoint["resume_centre"];
+        cout << "." << endl;
+    } else if (resume) {
+        cout << "No checkpoint '" << checkpoint_file << "' found, starting from the beginning." << endl;
+    }
+
+    //////////////////////////
+    //  BUILD MATCH MATRIX  //
+    //////////////////////////
+
+    I_map IUPAC_map;
+    int IUPAC_map_count;
+    int IUPAC_to_value[128];
+    int IUPAC_to_mask[128];
+    int complement[128];
+
+    // Initialize arrays
+    for (int i = 0; i < 128; ++i) {
+        IUPAC_to_value[i] = -1;
+        IUPAC_to_mask[i] = 0;
+        complement[i] = -1;
+    }
+
+    // Build IUPAC_map and IUPAC_to_value
+    // Note: 'u' and 't' are considered identical
+    // Note: 'n' and '*' and '-' are considered identical
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'a', {'a'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'c', {'c'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'g', {'g'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 't', {'t'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'u', {'t'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'r', {'a', 'g'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'y', {'c', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 's', {'g', 'c'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'w', {'a', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'k', {'g', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'm', {'a', 'c'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'b', {'c', 'g', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'd', {'a', 'g', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'h', {'a', 'c', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'v', {'a', 'c', 'g'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'n', {'a', 'c', 'g', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '*', {'a', 'c', 'g', 't'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '-', {'a', 'c', 'g', 't'});
+
+    // Non-IUPAC characters $ and # will be used within suffix tree
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '$', {'$'});
+    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '#', {'#'});
+
+    IUPAC_map_count = IUPAC_map.size();
+
+    char value_to_IUPAC[IUPAC_map_count];
+    bool* match_matrix = (bool*) malloc(IUPAC_map_count * IUPAC_map_count * sizeof(bool));
+
+    // Build array
+    for (int i = 0; i < 128; ++i) {
+        if (IUPAC_to_value[i] != -1) {
+            value_to_IUPAC[IUPAC_to_value[i]] = i;
+        }
+    }
+
+    // INFO:
+    //
+    // IUPAC_to_value:
+    // Given a character from IUPAC_map, returns a 0-based index
+    // according to the order of insertion into IUPAC_map
+    //
+    // value_to_IUPAC:
+    // Given a value from 0 to n - 1 (n = IUPAC_map size)
+    // returns the corresponding character, according to IUPAC_to_value
+    //
+    // i.e. IUPAC_to_value and value_to_IUPAC are inverse functions
+
+    // Build match matrix
+    for(I_map::iterator it1 = IUPAC_map.begin(); it1 != IUPAC_map.end(); it1++) {
+        for(I_map::iterator it2 = IUPAC_map.begin(); it2 != IUPAC_map.end(); it2++) {
+            char char1 = it1->first;
+            char char2 = it2->first;
+            int i = IUPAC_to_value[char1];
+            int j = IUPAC_to_value[char2];
+
+            bool match = false;
+            for(set<char>::iterator it_set1 = it1->second.begin(); it_set1 != it1->second.end(); it_set1++) {
+                for(set<char>::iterator it_set2 = it2->second.begin(); it_set2 != it2->second.end(); it_set2++) {
+                    if (*it_set1 == *it_set2) {
+                        match = true;
+                        break;
+                    }
+                }
+            }
+
+            if (match) {
+                set_value_for_matrix(match_matrix, IUPAC_map_count, i, j, true);
+            }
+            else {
+                set_value_for_matrix(match_matrix, IUPAC_map_count, i, j, false);
+            }
+        }
+    }
+
+    // Build mask array, with a bit per base (a = 1, c = 2, g = 4, t = 8) so that two characters match exactly when their masks share a bit
+    string bases = "acgt";
+
+    for(I_map::iterator it = IUPAC_map.begin(); it != IUPAC_map.end(); it++) {
+        for(set<char>::iterator it_set = it->second.begin(); it_set != it->second.end(); it_set++) {
+            if (bases.find(*it_set) != string::npos) {
+                IUPAC_to_mask[it->first] |= 1 << bases.find(*it_set);
+            }
+        }
+    }
+
+    // Assign static data structures to MatchMatrix class to enable use of MatchMatrix::match function
+    MatchMatrix::match_matrix = match_matrix;
+    MatchMatrix::IUPAC_map_count = IUPAC_map_count;
+    MatchMatrix::IUPAC_to_value = IUPAC_to_value;
+    MatchMatrix::IUPAC_to_mask = IUPAC_to_mask;
+
+    // Build complement array
+    complement['a'] = 't';
+    complement['c'] = 'g';
+    complement['g'] = 'c';
+    complement['t'] = 'a';
+    complement['u'] = 'a';
+    complement['r'] = 'y';
+    complement['y'] = 'r';
+    complement['s'] = 's';
+    complement['w'] = 'w';
+    complement['k'] = 'm';
+    complement['m'] = 'k';
+    complement['b'] = 'v';
+    complement['d'] = 'h';
+    complement['h'] = 'd';
+    complement['v'] = 'b';
+    complement['n'] = 'n';
+    complement['*'] = 'n';
+    complement['-'] = 'n';
+    complement['$'] = '$';
+    complement['#'] = '#';
+
+    // Optionally print match matrix
+    #ifdef _DIAGNOSTICS
+        string letters = "acgturyswkmbdhvn*-$#";
+
+        cout << "Match Matrix:" << endl;
+
+        cout << "  ";
+        for (int i = 0; i < IUPAC_map_count; ++i) {
+            cout << letters[i] << " ";
+        }
+        cout << endl;
+
+        for (int i = 0; i < IUPAC_map_count; ++i) {
+            cout << letters[i] << " ";
+            for (int j = 0; j < IUPAC_map_count; ++j) {
+                cout << MatchMatrix::match(letters[i], complement[letters[j]]) << " ";
+            }
+            cout << endl;
+        }
+
+        cout << endl << endl;
+    #endif
+
+    /////////////////////////////
+    //  CALCULATE PALINDROMES  //
+    /////////////////////////////
+
+    tuple<int, int, int, int> params(min_len, max_len, mismatches, max_gap);
+
+    // NUMA placement applies when the threads span several nodes, each taking an equal share of them
+    vector<NumaNode> nodes;
+
+    if (numa_mode != "off") {
+        nodes = numaNodes();
+        nodes.resize(min((int) nodes.size(), threads));
+    }
+
+    bool numa = (nodes.size() > 1);
+
+    if (numa and numa_mode == "interleave") {
+        cout << "Interleaving index over " << nodes.size() << " NUMA nodes." << endl;
+    }
+
+    if (numa and numa_mode == "replicate") {
+        cout << "Replicating index on " << nodes.size() << " NUMA nodes." << endl;
+    }
+
+    #ifndef _USE_NLOGN_RMQ
+        // sdsl holds LCP and the RMQ data, in reserved huge pages if enough are free for the two largest indexes held at once
+        if (hugepages and engine != ENGINE_CST and engine != ENGINE_COMPRESSED) {
+            long int longest = 0;
+
+            for (auto entry : seq_lengths) {
+                longest = max(longest, entry.second);
+            }
+
+            size_t lcp_bytes = (2 * longest + 2) * (bits::hi(2 * longest + 2) + 1) / 8 + 8;
+
+            try {
+                memory_manager::use_hugepages(2 * ((4 * lcp_bytes + 4 * longest + 4) / ARENA_PAGE + 1) * ARENA_PAGE);
+            }
+            catch (std::system_error &) {
+                // Left to the usual allocator
+            }
+        }
+    #endif
+
+    // Arenas of the indexes built in memory, kept for the next records once searched
+    ArenaPool arena_pool;
+
+    // Builds S and, for the engines searching a suffix array, the index of a sequence
+    auto indexRecord = [&](Record* record) {
+        long int n = record->n;
+        unsigned char * seq = record->seq->data() + (record->text_offset - record->offset);
+
+        //////////////////////////////////////////////////////////////
+        //  CONSTRUCT S = seq + '$' + complement(reverse(seq) + '#' //
+        //////////////////////////////////////////////////////////////
+
+        PhaseScope text_phase(PHASE_TEXT);
+
+        record->S_n = 2 * n + 2;
+        record->S.resize(record->S_n + 8);
+
+        int S_n = record->S_n;
+        unsigned char * S = record->S.data();
+
+        for (int i = 0; i < n; ++i) {
+            S[i] = seq[i];
+        }
+
+        S[n] = '$';
+
+        for (int i = 0; i < n; ++i) {
+            S[n + 1 + i] = complement[seq[n - 1 - i]];
+        }
+
+        S[2 * n + 1] = '#';
+
+        // Padding read by wordLCE
+        memset(S + S_n, 0, 8);
+
+        text_phase.end();
+
+        // The diagonal and suffix tree engines need no suffix array, so are chosen before building one
+        record->engine = engine;
+
+        if (record->engine == ENGINE_AUTO and auto_diagonal and diagonalPreferred(S, n, params)) {
+            record->engine = ENGINE_DIAGONAL;
+        }
+
+        // Planned without an index, or with a compressed one
+        if (record->plan == PLAN_NONE) {
+            record->engine = ENGINE_DIAGONAL;
+        }
+        if (record->plan == PLAN_COMPRESSED) {
+            record->engine = ENGINE_COMPRESSED;
+        }
+
+        // The suffix tree engine relies on matching characters being equal
+        if (record->engine == ENGINE_CST and !record->pure_bases) {
+            record->engine = ENGINE_EXACT;
+        }
+
+        if (record->engine == ENGINE_DIAGONAL or record->engine == ENGINE_CST or record->engine == ENGINE_COMPRESSED) {
+            if (index_prefix != "" and !checkpoint_index) {
+                cout << "Engine '" << engine_names[record->engine] << "' searching '" << record->name << "' uses no suffix array, so no index is stored." << endl;
+            }
+            if (scan_counting) {
+                cout << "Engine '" << engine_names[record->engine] << "' searching '" << record->name << "' does not count the work of scanning centres." << endl;
+            }
+
+            return;
+        }
+
+        INT *& SA = record->SA;
+        INT *& invSA = record->invSA;
+        IndexArena& arena = record->arena;
+        bool& mapped = record->mapped;
+        bool& external = record->external;
+
+        #ifdef _USE_NLOGN_RMQ
+            INT *& LCP = record->LCP;
+            INT *& A = record->A;
+        #else
+            int_vector<> &LCP = record->LCP;
+            rmq_succinct_sct<> &rmq = record->rmq;
+        #endif
+
+        // Each sequence (and each window of it) has its own index files when several are searched
+        string prefix = (seq_names.size() > 1) ? index_prefix + "." + record->name : index_prefix;
+
+        if (record->windows > 1) {
+            prefix += "." + to_string(record->window + 1);
+        }
+
+        // A stored index of the same text is mapped from its files rather than built
+        if (index_prefix != "") {
+            PhaseScope phase(PHASE_INDEX_FILES);
+
+            #ifdef _USE_NLOGN_RMQ
+                mapped = openIndex(prefix, S, S_n, &invSA, &LCP, &A);
+            #else
+                mapped = openIndex(prefix, S, S_n, &invSA, LCP, rmq);
+            #endif
+
+            if (mapped) {
+                cout << "Using index '" << prefix << "'." << endl;
+            }
+        }
+
+        // Indexes planned on disk, or larger than the memory limit, are built on disk, and searched through arrays mapped from their
+        // files
+        external = (!mapped and (record->plan == PLAN_DISK or (memory_limit > 0 and indexMemory(S_n) > memory_limit * 1024 * 1024)));
+
+        if (mapped) {
+            // Nothing to build
+        }
+        else if (external) {
+            PhaseScope phase(PHASE_EXTERNAL_INDEX);
+            cout << "Building index on disk in '" << scratch_dir << "'." << endl;
+
+            #ifdef _USE_NLOGN_RMQ
+                bool built = buildIndexExternal(S, S_n, scratch_dir, &invSA, &LCP, &A);
+            #else
+                bool built = buildIndexExternal(S, S_n, scratch_dir, &invSA, LCP, rmq);
+            #endif
+
+            if ( !built )
+            {
+                fprintf(stderr, " Error: Cannot build index in '%s'.\n", scratch_dir.c_str() );
+                exit( EXIT_FAILURE );
+            }
+        }
+        else {
+            // The index arrays are taken from a single arena, reused from an earlier record when one is large enough
+            if ( !takeArena(&arena_pool, &arena, arenaMemory(S_n), hugepages) )
+            {
+                fprintf(stderr, " Error: Cannot allocate memory for index.\n" );
+                exit( EXIT_FAILURE );
+            }
+
+            if (hugepages) {
+                cout << "Index arena: " << arena.size / (1024 * 1024) << " MB in " << (arena.hugetlb ? "reserved" : "transparent") << " huge pages." << endl;
+            }
+
+            ///////////////////////////////////
+            //  CALCULATE Suffix Array (SA)  //
+            ///////////////////////////////////
+
+            PhaseScope phase(PHASE_SUFFIX_ARRAY);
+
+            SA = arenaArray(&arena, S_n);
+
+            if( ( SA == NULL) )
+            {
+                fprintf(stderr, " Error: Cannot allocate memory for SA.\n" );
+                exit( EXIT_FAILURE );
+            }
+
+            #ifdef _USE_64
+                if( divsufsort64( S, SA,  S_n ) != 0 )
+                {
+                    fprintf(stderr, " Error: SA computation failed.\n" );
+                    exit( EXIT_FAILURE );
+                }
+            #endif
+
+            #ifdef _USE_32
+                if( divsufsort( S, SA,  S_n ) != 0 )
+                {
+                    fprintf(stderr, " Error: SA computation failed.\n" );
+                    exit( EXIT_FAILURE );
+                }
+            #endif
+
+            //////////////////////////////////////////////
+            //  CALCULATE Inverse Suffix Array (invSA)  //
+            //////////////////////////////////////////////
+
+            phase.next(PHASE_INVERSE_SUFFIX_ARRAY);
+
+            invSA = arenaArray(&arena, S_n);
+
+            if( ( invSA == NULL) )
+            {
+                fprintf(stderr, " Error: Cannot allocate memory for invSA.\n" );
+                exit( EXIT_FAILURE );
+            }
+
+            for ( INT i = 0; i < S_n; i ++ )
+            {
+                invSA [SA[i]] = i;
+            }
+
+            ///////////////////////////////////////////////////
+            //  CALCULATE Longest Common Prefix Array (LCP)  //
+            ///////////////////////////////////////////////////
+
+            phase.next(PHASE_LCP);
+
+            #ifdef _USE_NLOGN_RMQ
+                LCP = arenaArray(&arena, S_n);
+
+                if( ( LCP == NULL) )
+                {
+                    fprintf(stderr, " Error: Cannot allocate memory for LCP.\n" );
+                    exit( EXIT_FAILURE );
+                }
+            #else
+                LCP = int_vector<>(S_n, 0, bits::hi(S_n) + 1); // LCP values are below S_n
+            #endif
+
+            if( LCParray( S, S_n, SA, invSA, LCP ) != 1 )
+            {
+                fprintf(stderr, " Error: LCP computation failed.\n" );
+                exit( EXIT_FAILURE );
+            }
+
+            #ifndef _USE_NLOGN_RMQ
+                util::bit_compress(LCP); // Narrow to the width of the largest LCP value, in place
+            #endif
+
+            ////////////////////////////
+            //  CALCULATE RMQ of LCP  //
+            ////////////////////////////
+
+            phase.next(PHASE_RMQ);
+
+            #ifdef _USE_NLOGN_RMQ
+                INT l = S_n;
+                INT lgl = flog2( l );
+                A = arenaArray(&arena, ( INT ) l * lgl);
+                rmq_preprocess(A, LCP, l);
+            #else
+                rmq = rmq_succinct_sct<>(&LCP);
+            #endif
+        }
+
+        if (!mapped and index_prefix != "") {
+            PhaseScope phase(PHASE_INDEX_FILES);
+
+            #ifdef _USE_NLOGN_RMQ
+                bool stored = storeIndex(prefix, S, S_n, invSA, LCP, A);
+            #else
+                bool stored = storeIndex(prefix, S, S_n, invSA, LCP, rmq);
+            #endif
+
+            if ( !stored )
+            {
+                fprintf(stderr, " Error: Cannot write index '%s'.\n", prefix.c_str() );
+                exit( EXIT_FAILURE );
+            }
+        }
+    };
+
+    // Finds the palindromes of a sequence, passing them on to its result store, then releases its index and S
+    auto searchRecord = [&](Record* record) {
+        long int n = record->n;
+        unsigned char * seq = record->seq->data() + (record->text_offset - record->offset);
+        int S_n = record->S_n;
+        unsigned char * S = record->S.data();
+        bool pure_bases = record->pure_bases;
+        Engine engine = record->engine;
+        P_buffer& palindromes = record->palindromes;
+        PhaseScope phase(PHASE_SCAN);
+
+        // Centres of the window, in its text (the store narrows those scanned by the other engines)
+        long int window_from = record->window_from - record->text_offset;
+        long int window_to = record->window_to - record->text_offset;
+        bool last = (record->window == record->windows - 1);
+
+        if (engine == ENGINE_DIAGONAL) {
+            addPalindromesDiagonal(&palindromes, S, n, params, threads);
+        }
+        else if (engine == ENGINE_CST) {
+            addPalindromesSuffixTree(&palindromes, S, S_n, n, min_len, max_len, max_gap);
+        }
+        else if (engine == ENGINE_COMPRESSED) {
+            addPalindromesCompressed(&palindromes, S, S_n, n, params, scratch_dir, threads);
+        }
+        else {
+            INT * SA = record->SA;
+            INT * invSA = record->invSA;
+            IndexArena& arena = record->arena;
+            bool mapped = record->mapped;
+            bool external = record->external;
+
+            #ifdef _USE_NLOGN_RMQ
+                INT * LCP = record->LCP;
+                INT * A = record->A;
+            #else
+                int_vector<> &LCP = record->LCP;
+                rmq_succinct_sct<> &rmq = record->rmq;
+            #endif
+
+            // Optional printing of data structures
+            if (false) {
+                cout << endl << endl;
+                print_array("  seq", seq, n);
+                print_array("    S", S, S_n, true);
+                if (SA != NULL) print_array("   SA", SA, S_n, true);
+                print_array("invSA", invSA, S_n, true);
+                print_array("  LCP", LCP, S_n, true);
+                cout << endl << endl;
+            }
+
+            // All palindromes calculate and stored
+            if (numa) {
+                // Each node scans an equal range of centres on its own threads, reading its replica of the index if there is one
+                int nodes_n = nodes.size();
+                vector<P_buffer> node_palindromes(nodes_n);
+                vector<IndexReplica> replicas(nodes_n);
+                vector<thread> node_threads;
+
+                for (int i = 0; i < nodes_n; i++) {
+                    node_palindromes[i].store = palindromes.store;
                 }
-                while ( i < line_length && line[i] != ' ' ) {
-                    name += line[i];
-                    i++;
+
+                for (int i = 0; i < nodes_n; i++) {
+                    node_threads.push_back(thread([&, i]() {
+                        pinToNode(nodes[i]);
+                        traceThread("numa node");
+                        WorkerPhase worker_phase(PHASE_SCAN);
+
+                        int node_threads_n = threads * (i + 1) / nodes_n - threads * i / nodes_n;
+                        int centres_from = window_from + (window_to - window_from) * i / nodes_n;
+                        int centres_to = window_from + (window_to - window_from) * (i + 1) / nodes_n;
+
+                        // Nodes whose replica cannot be allocated read the index on the first node
+                        #ifdef _USE_NLOGN_RMQ
+                            if (numa_mode == "replicate" and i > 0 and replicateIndex(&replicas[i], S_n, invSA, LCP, A, hugepages)) {
+                                addPalindromes(&node_palindromes[i], S, S_n, n, replicas[i].invSA, replicas[i].LCP, replicas[i].A, engine, params, pure_bases, node_threads_n, centres_from, centres_to);
+                            } else {
+                                addPalindromes(&node_palindromes[i], S, S_n, n, invSA, LCP, A, engine, params, pure_bases, node_threads_n, centres_from, centres_to);
+                            }
+                        #else
+                            if (numa_mode == "replicate" and i > 0 and replicateIndex(&replicas[i], S_n, invSA, LCP, rmq, hugepages)) {
+                                addPalindromes(&node_palindromes[i], S, S_n, n, replicas[i].invSA, replicas[i].LCP, replicas[i].rmq, engine, params, pure_bases, node_threads_n, centres_from, centres_to);
+                            } else {
+                                addPalindromes(&node_palindromes[i], S, S_n, n, invSA, LCP, rmq, engine, params, pure_bases, node_threads_n, centres_from, centres_to);
+                            }
+                        #endif
+                    }));
+                }
+
+                for (int i = 0; i < nodes_n; i++) {
+                    node_threads[i].join();
+                    palindromes.insert(palindromes.end(), node_palindromes[i].begin(), node_palindromes[i].end());
+                    P_buffer().swap(node_palindromes[i]);
+                    closeArena(&replicas[i].arena);
                 }
             }
+            else {
+                #ifdef _USE_NLOGN_RMQ
+                    addPalindromes(&palindromes, S, S_n, n, invSA, LCP, A, engine, params, pure_bases, threads, window_from, window_to);
+                #else
+                    addPalindromes(&palindromes, S, S_n, n, invSA, LCP, rmq, engine, params, pure_bases, threads, window_from, window_to);
+                #endif
+            }
 
-            // Sequence name found
-            if (name == seq_name) {
-                found_seq = true;
+            if (mapped) {
+                unmapVector(invSA, S_n, 8 * sizeof(INT));
+
+                #ifdef _USE_NLOGN_RMQ
+                    unmapVector(LCP, S_n, 8 * sizeof(INT));
+                    unmapVector(A, S_n * flog2(S_n), 8 * sizeof(INT));
+                #endif
             }
+            else if (external) {
+                unmapArray(invSA, S_n);
 
-            name = "";
-        }
-        // Once sequence name is found, extract sequence
-        else {
-            if (line[0] != ' ' && line[0] != '>' && line[0] != ';') {
-                contents += line;
+                #ifdef _USE_NLOGN_RMQ
+                    unmapArray(LCP, S_n);
+                    unmapArray(A, S_n * flog2(S_n));
+                #endif
             }
             else {
-                // End of sequence
-                break;
+                returnArena(&arena_pool, &arena);
             }
+
+            #ifndef _USE_NLOGN_RMQ
+                int_vector<>().swap(record->LCP);
+                record->rmq = rmq_succinct_sct<>();
+            #endif
         }
-    }
 
-    // Check if sequence name was found, exit if not
-    if (!found_seq) {  usage(); cout << "Error: Sequence '" + seq_name + "' not found in file '" + input_file + "'." << endl; return -1; }
+        vector<unsigned char>().swap(record->S);
 
-    long int n = contents.length();
-    unsigned char * seq = ( unsigned char* ) malloc( ( n ) * sizeof( unsigned char ) );
+        // Palindromes not passed on by scanCentres (those of the cst engine) are added last; the sequence may be released once
+        // the store is finished, after its last window
+        record->results->add(&palindromes, 0, 0);
 
-    // Convert extracted sequence to character array, all lowercase
-    for (int i = 0; i < n; ++i) {
-        seq[i] = contents[i];
-        seq[i] = tolower(seq[i]);
-    }
+        if (last) {
+            record->results->finish();
+        }
+    };
 
-    // Verify arguments are valid with respect to individual limits
-    if (min_len < 2) { usage(); cout << "Error: min_len must not be less than 2." << endl; return -1; }
-    if (min_len > INT_MAX) { usage(); cout << "Error: min_len must not greater than " << INT_MAX << "." << endl; return -1; }
-    if (max_len < 0) { usage(); cout << "Error: max_len must not be a negative value." << endl; return -1; }
-    if (max_len > INT_MAX) { usage(); cout << "Error: max_len must not greater than " << INT_MAX << "." << endl; return -1; }
-    if (max_gap < 0) { usage(); cout << "Error: max_gap must not be a negative value." << endl; return -1; }
-    if (max_gap > INT_MAX) { usage(); cout << "Error: max_gap must not greater than " << INT_MAX << "." << endl; return -1; }
-    if (mismatches < 0) { usage(); cout << "Error: mismatches must not be a negative value." << endl; return -1; }
-    if (mismatches > INT_MAX) { usage(); cout << "Error: mismatches must not greater than " << INT_MAX << "." << endl; return -1; }
+    /////////////////////////
+    //  PRINT PALINDROMES  //
+    /////////////////////////
 
-    // Verify arguments are valid with respect to each other
-    if (min_len >= n) { usage(); cout << "Error: min_len must be less than sequence length." << endl; return -1; }
-    if (max_len < min_len) { usage(); cout << "Error: max_len must not be less than min_len." << endl; return -1; }
-    if (max_gap >= n) { usage(); cout << "Error: max_gap must be less than sequence length." << endl; return -1; }
-    if (min_len >= n) { usage(); cout << "Error: min_len must be less than sequence length." << endl; return -1; }
-    if (mismatches >= n) { usage(); cout << "Error: mismatches must be less than sequence length." << endl; return -1; }
-    if (mismatches >= min_len) { usage(); cout << "Error: mismatches must be less than min_len." << endl; return -1; }
+    // Formats a block of sorted palindromes of a sequence (with indexes in the whole sequence), which holds whole left index groups
+    auto formatPalindromes = [&](ostream& file, Record* record, P_buffer* block) {
+        unsigned char * seq = record->seq->data();
+        long int offset = record->offset;
+        P_buffer& palindromes = *block;
+        long int from = 0;
+        long int to = palindromes.size();
 
-    // Optionally display user given options
-    if (true) {
-    	cout << endl;
-        cout << "input_file: " << input_file << endl;
-        cout << "seq_name: " << seq_name << endl;
+        // Each left index group is printed in reverse order
+        for (long int group_end = from; group_end < to; ) {
+            long int group_start = group_end;
 
-        // Optionally print sequence data
-        if (false) {
-        	cout << "sequence: " << contents << endl;
-        }
+            while (group_end < to and get<0>(palindromes[group_end]) == get<0>(palindromes[group_start])) {
+                group_end++;
+            }
 
-        cout << "min_len: " << min_len << endl;
-        cout << "max_len: " << max_len << endl;
-        cout << "max_gap: " << max_gap << endl;
-        cout << "mismatches: " << mismatches << endl;
-        cout << "output_file: " << output_file << endl;
-        cout << endl;
-    }
+            for (long int it = group_end - 1; it >= group_start; it--) {
+                int left = get<0>(palindromes[it]);
+                int right = get<1>(palindromes[it]);
+                int gap = get<2>(palindromes[it]);
 
-    //////////////////////////
-    //  BUILD MATCH MATRIX  //
-    //////////////////////////
+                int outer_left = left + 1;
+                int outer_right = right + 1;
+                int inner_left = (outer_left + outer_right - 1 - gap) / 2;
+                int inner_right = (outer_right + outer_left + 1 + gap) / 2;
 
-    I_map IUPAC_map;
-    int IUPAC_map_count;
-    int IUPAC_to_value[128];
-    int complement[128];
+                string pad = "         ";
+                int pad_length = pad.size();
 
-    // Initialize arrays
-    for (int i = 0; i < 128; ++i) {
-        IUPAC_to_value[i] = -1;
-        complement[i] = -1;
-    }
+                file << outer_left;
+                for (int i = 0; i < pad_length - getDigitCount(outer_left); ++i) { file << " "; }
+                for (int i = outer_left; i <= inner_left; ++i) { file << seq[i - 1 - offset]; }
+                for (int i = 0; i < pad_length - getDigitCount(inner_left); ++i) { file << " "; }
+                file << inner_left;
 
-    // Build IUPAC_map and IUPAC_to_value
-    // Note: 'u' and 't' are considered identical
-    // Note: 'n' and '*' and '-' are considered identical
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'a', {'a'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'c', {'c'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'g', {'g'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 't', {'t'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'u', {'t'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'r', {'a', 'g'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'y', {'c', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 's', {'g', 'c'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'w', {'a', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'k', {'g', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'm', {'a', 'c'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'b', {'c', 'g', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'd', {'a', 'g', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'h', {'a', 'c', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'v', {'a', 'c', 'g'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, 'n', {'a', 'c', 'g', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '*', {'a', 'c', 'g', 't'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '-', {'a', 'c', 'g', 't'});
+                file << "\n";
 
-    // Non-IUPAC characters $ and # will be used within suffix tree
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '$', {'$'});
-    IUPAC_map_insert(&IUPAC_map, IUPAC_to_value, '#', {'#'});
+                file << pad;
+                for (int i = 0; i < (inner_left - outer_left + 1); ++i) {
+                    file << ( (MatchMatrix::match(seq[ outer_left - 1 - offset + i ], complement[ seq[ outer_right - 1 - offset - i ] ])) ? "|" : " " );
+                }
 
-    IUPAC_map_count = IUPAC_map.size();
+                file << "\n";
 
-    char value_to_IUPAC[IUPAC_map_count];
-    bool* match_matrix = (bool*) malloc(IUPAC_map_count * IUPAC_map_count * sizeof(bool));
+                file << outer_right;
+                for (int i = 0; i < pad_length - getDigitCount(outer_right); ++i) { file << " "; }
+                for (int i = outer_right; i >= inner_right; --i) { file << seq[i - 1 - offset]; }
+                for (int i = 0; i < pad_length - getDigitCount(inner_right); ++i) { file << " "; }
+                file << inner_right;
 
-    // Build array
-    for (int i = 0; i < 128; ++i) {
-        if (IUPAC_to_value[i] != -1) {
-            value_to_IUPAC[IUPAC_to_value[i]] = i;
+                file << "\n" << "\n";
+            }
         }
-    }
+    };
 
-    // INFO:
-    //
-    // IUPAC_to_value:
-    // Given a character from IUPAC_map, returns a 0-based index
-    // according to the order of insertion into IUPAC_map
-    //
-    // value_to_IUPAC:
-    // Given a value from 0 to n - 1 (n = IUPAC_map size)
-    // returns the corresponding character, according to IUPAC_to_value
-    //
-    // i.e. IUPAC_to_value and value_to_IUPAC are inverse functions
+    // Checkpoint of a search once the sequences before a given one are written, and optionally the palindromes of that sequence
+    // starting before a given centre (with its header)
+    auto checkpointMark = [&](long int records, Record* record, int given) {
+        if (checkpoint_file == "") {
+            return string();
+        }
 
-    // Build match matrix
-    for(I_map::iterator it1 = IUPAC_map.begin(); it1 != IUPAC_map.end(); it1++) {
-        for(I_map::iterator it2 = IUPAC_map.begin(); it2 != IUPAC_map.end(); it2++) {
-            char char1 = it1->first;
-            char char2 = it2->first;
-            int i = IUPAC_to_value[char1];
-            int j = IUPAC_to_value[char2];
+        string mark = "IUPACpal checkpoint\n";
 
-            bool match = false;
-            for(set<char>::iterator it_set1 = it1->second.begin(); it_set1 != it1->second.end(); it_set1++) {
-                for(set<char>::iterator it_set2 = it2->second.begin(); it_set2 != it2->second.end(); it_set2++) {
-                    if (*it_set1 == *it_set2) {
-                        match = true;
-                        break;
-                    }
-                }
-            }
+        for (auto& value : search) {
+            mark += value.first + ": " + value.second + "\n";
+        }
 
-            if (match) {
-                set_value_for_matrix(match_matrix, IUPAC_map_count, i, j, true);
-            }
-            else {
-                set_value_for_matrix(match_matrix, IUPAC_map_count, i, j, false);
-            }
+        mark += "index: " + index_prefix + "\n";
+        mark += "sequences_written: " + to_string(records) + "\n";
+
+        if (record != NULL) {
+            mark += "sequence_name: " + record->name + "\n";
+            mark += "resume_centre: " + to_string(max(0, given)) + "\n";
         }
-    }
 
-    // Assign static data structures to MatchMatrix class to enable use of MatchMatrix::match function
-    MatchMatrix::match_matrix = match_matrix;
-    MatchMatrix::IUPAC_map_count = IUPAC_map_count;
-    MatchMatrix::IUPAC_to_value = IUPAC_to_value;
+        return mark;
+    };
+
+    // Writes the palindromes of a sequence to the output, as blocks formatted on the output's threads
+    auto printRecord = [&](OutputSink* output, Record* record) {
+        long int n = record->length;
+        ResultStore& results = *record->results;
+        long int number = record->number;
+        string name = record->name;
+        int windows = record->windows;
+
+        // The sequence is released once its last block is formatted
+        shared_ptr<Record> owner(record);
+
+        // A shard gives the range of centres it searched as its start and end positions; a resumed search has written its header
+        if (!record->resumed) {
+            output->add([&, owner, n]() {
+                stringstream file;
+
+                file << "Palindromes of: " << input_file << endl;
+                file << "Sequence name: " << owner->name << endl;
+                file << "Sequence length is: " << n << endl;
+                file << "Start at position: " << owner->shard_from + 1 << endl;
+                file << "End at position: " << owner->shard_to << endl;
+                file << "Minimum length of Palindromes is: "  << min_len << endl;
+                file << "Maximum length of Palindromes is: "  << max_len << endl;
+                file << "Maximum gap between elements is: "  << max_gap << endl;
+                file << "Number of mismatches allowed in Palindrome: " << mismatches << endl;
+                file << endl << endl << endl;
+                file << "Palindromes:" << endl;
+
+                return file.str();
+            });
+        }
 
-    // Build complement array
-    complement['a'] = 't';
-    complement['c'] = 'g';
-    complement['g'] = 'c';
-    complement['t'] = 'a';
-    complement['u'] = 'a';
-    complement['r'] = 'y';
-    complement['y'] = 'r';
-    complement['s'] = 's';
-    complement['w'] = 'w';
-    complement['k'] = 'm';
-    complement['m'] = 'k';
-    complement['b'] = 'v';
-    complement['d'] = 'h';
-    complement['h'] = 'd';
-    complement['v'] = 'b';
-    complement['n'] = 'n';
-    complement['*'] = 'n';
-    complement['-'] = 'n';
+        // Palindromes are taken from the store while the search goes on, sorted by left index without duplicates, in blocks
+        // ending with a whole left index group; each block marks the checkpoint reached once it is written, and blocks left empty
+        // mark progress through centres without palindromes, once per checkpoint interval
+        chrono::steady_clock::time_point marked = chrono::steady_clock::now();
 
-    // Optionally print match matrix
-    #ifdef _DIAGNOSTICS
-        string letters = "acgturyswkmbdhvn*-$#";
+        while (true) {
+            shared_ptr<P_buffer> block(new P_buffer());
+            int given;
 
-        cout << "Match Matrix:" << endl;
+            if (!results.next(block.get(), OUTPUT_BLOCK, &given)) {
+                break;
+            }
 
-        cout << "  ";
-        for (int i = 0; i < IUPAC_map_count; ++i) {
-            cout << letters[i] << " ";
-        }
-        cout << endl;
+            if (block->empty()) {
+                if (checkpoint_file != "" and chrono::steady_clock::now() - marked >= chrono::seconds(checkpoint_interval)) {
+                    output->add([]() { return string(); }, checkpointMark(number, owner.get(), given));
+                    marked = chrono::steady_clock::now();
+                }
 
-        for (int i = 0; i < IUPAC_map_count; ++i) {
-            cout << letters[i] << " ";
-            for (int j = 0; j < IUPAC_map_count; ++j) {
-                cout << MatchMatrix::match(letters[i], complement[letters[j]]) << " ";
+                continue;
             }
-            cout << endl;
-        }
 
-        cout << endl << endl;
-    #endif
+            output->add([&, owner, block]() {
+                stringstream file;
+                formatPalindromes(file, owner.get(), block.get());
+                return file.str();
+            }, checkpointMark(number, owner.get(), given));
 
-    //////////////////////////////////////////////////////////////
-    //  CONSTRUCT S = seq + '$' + complement(reverse(seq) + '#' //
-    //////////////////////////////////////////////////////////////
+            marked = chrono::steady_clock::now();
+        }
 
-    int S_n = 2 * n + 2;
-    unsigned char S[S_n];
+        if (results.spilled() > 0) {
+            cout << "Merged " << results.spilled() << " runs of palindromes from '" << scratch_dir << "'." << endl;
+        }
 
-    for (int i = 0; i < n; ++i) {
-        S[i] = seq[i];
-    }
+        results.close();
 
-    S[n] = '$';
+        output->add([]() {
+            return string("\n\n\n");
+        }, checkpointMark(number + 1, NULL, 0));
 
-    for (int i = 0; i < n; ++i) {
-        S[n + 1 + i] = complement[seq[n - 1 - i]];
-    }
+        // An index stored only for the checkpoint is not needed once the sequence is searched
+        if (checkpoint_index) {
+            string prefix = (seq_names.size() > 1) ? index_prefix + "." + name : index_prefix;
+
+            for (int window = 0; window < windows; window++) {
+                removeIndex((windows > 1) ? prefix + "." + to_string(window + 1) : prefix);
+            }
+        }
+    };
 
-    S[2 * n + 1] = '#';
+    ///////////////////////
+    //  SEARCH PIPELINE  //
+    ///////////////////////
 
-    ///////////////////////////////////
-    //  CALCULATE Suffix Array (SA)  //
-    ///////////////////////////////////
+    // Output is formatted and written on threads of its own, so the search never waits for the disk
+    OutputSink output;
 
-    INT * SA;
-    SA = ( INT * ) malloc( ( S_n ) * sizeof( INT ) );
+    if (!output.open(output_file, threads, resume_bytes)) { cout << "Error: Cannot write '" + output_file + "'." << endl; return -1; }
 
-    if( ( SA == NULL) )
-    {
-        fprintf(stderr, " Error: Cannot allocate memory for SA.\n" );
-        return 0;
+    if (checkpoint_file != "") {
+        output.checkpoint(checkpoint_file, checkpoint_interval);
     }
 
-    #ifdef _USE_64
-        if( divsufsort64( S, SA,  S_n ) != 0 )
-        {
-            fprintf(stderr, " Error: SA computation failed.\n" );
-            exit( EXIT_FAILURE );
-        }
-    #endif
+    // Sequences pass through four stages, each on its own thread, so that reading, index construction, search and output of
+    // different sequences overlap. An index is handed to the search only once the search of the previous sequence is done, so
+    // at most two are held at once. A sequence is handed to the output as its search starts, and written out as it goes on
+    Pipe<Record*> read_records(1);
+    Pipe<Record*> indexed_records(0);
+    Pipe<Record*> searched_records(1);
+
+    // Peak memory predicted by the plans, and the memory of the index planned for the previous sequence
+    long int predicted_memory = 0;
+    long int previous_index = 0;
+
+    // Memory held besides sequences and indexes: the program, and blocks of output waiting to be written (of palindromes mostly
+    // about the shortest length)
+    long int held_memory = PLAN_BASE_MEMORY + (4L * threads + 4) * OUTPUT_BLOCK * (3L * min_len + PLAN_OUTPUT_BYTES);
+
+    thread reading([&]() {
+        traceThread("reader");
+        FastaReader reader;
+        reader.input.open(input_file);
+        set<string> names(seq_names.begin(), seq_names.end());
+        string name;
+        string contents;
+        long int n;
+
+        for (long int number = 0; nextRecord(&reader, &names, &name, &contents, &n); number++) {
+            // Sequences written before a checkpoint are not searched again
+            if (number < resume_records) {
+                continue;
+            }
 
-    #ifdef _USE_32
-        if( divsufsort( S, SA,  S_n ) != 0 )
-        {
-            fprintf(stderr, " Error: SA computation failed.\n" );
-            exit( EXIT_FAILURE );
-        }
-    #endif
+            // A shard searches its centres in the part of the sequence their palindromes may reach, indexing only that part
+            long int shard_from = n * (shard_k - 1) / shard_n;
+            long int shard_to = n * shard_k / shard_n;
+            long int offset = max(0L, shard_from - reach);
+            long int seq_n = min(n, shard_to + reach) - offset;
+            PhaseScope phase(PHASE_READ);
+            shared_ptr< vector<unsigned char> > seq(new vector<unsigned char>(seq_n));
+
+            // Whether the sequence holds only 'a', 'c', 'g', 't', so that characters match exactly when complementary
+            bool pure_bases = true;
+
+            // Convert extracted sequence to character array, all lowercase
+            for (int i = 0; i < seq_n; ++i) {
+                (*seq)[i] = tolower(contents[offset + i]);
+                pure_bases = pure_bases and ((*seq)[i] == 'a' or (*seq)[i] == 'c' or (*seq)[i] == 'g' or (*seq)[i] == 't');
+            }
 
-    //////////////////////////////////////////////
-    //  CALCULATE Inverse Suffix Array (invSA)  //
-    //////////////////////////////////////////////
+            phase.end();
 
-    INT * invSA;
-    invSA = ( INT * ) malloc( S_n * sizeof( INT ) );
+            // With a limit on all memory, the index is planned to fit, searching in windows of centres if need be
+            PlanChoice choice = { PLAN_MEMORY, shard_to - shard_from, 0, 0, 0.0 };
 
-    if( ( invSA == NULL) )
-    {
-        fprintf(stderr, " Error: Cannot allocate memory for invSA.\n" );
-        return 0;
-    }
+            if (max_memory > 0) {
+                PhaseScope plan_phase(PHASE_PLAN);
+                vector<Plan> plans = { PLAN_MEMORY, PLAN_WINDOWED, PLAN_DISK };
 
-    for ( INT i = 0; i < S_n; i ++ )
-    {
-        invSA [SA[i]] = i;
-    }
+                // Engines needing no suffix array have only their own plan
+                if (engine == ENGINE_COMPRESSED) {
+                    plans = { PLAN_COMPRESSED };
+                }
+                if (engine == ENGINE_DIAGONAL) {
+                    plans = { PLAN_NONE };
+                }
+                if (engine == ENGINE_CST and pure_bases) {
+                    plans = { PLAN_TREE };
+                }
 
-    ///////////////////////////////////////////////////
-    //  CALCULATE Longest Common Prefix Array (LCP)  //
-    ///////////////////////////////////////////////////
+                if (engine == ENGINE_AUTO and auto_diagonal) {
+                    vector<unsigned char> S(2 * seq_n + 2 + 8, 0);
 
-    INT * LCP;
-    LCP = ( INT * ) malloc  ( S_n * sizeof( INT ) );
+                    for (long int i = 0; i < seq_n; ++i) {
+                        S[i] = (*seq)[i];
+                        S[seq_n + 1 + i] = complement[(*seq)[seq_n - 1 - i]];
+                    }
 
-    if( ( LCP == NULL) )
-    {
-        fprintf(stderr, " Error: Cannot allocate memory for LCP.\n" );
-        return 0;
-    }
+                    S[seq_n] = '$';
+                    S[2 * seq_n + 1] = '#';
 
-    if( LCParray( S, S_n, SA, invSA, LCP ) != 1 )
-    {
-        fprintf(stderr, " Error: LCP computation failed.\n" );
-        exit( EXIT_FAILURE );
-    }
+                    if (diagonalPreferred(S.data(), seq_n, params)) {
+                        plans = { PLAN_NONE };
+                    }
+                }
 
-    ////////////////////////////
-    //  CALCULATE RMQ of LCP  //
-    ////////////////////////////
+                long int available = (max_memory - results_memory) * 1024 * 1024;
 
-    #ifdef _USE_NLOGN_RMQ
-        INT l = S_n;
-        INT lgl = flog2( l );
-        INT * A = ( INT * ) calloc( ( INT ) l * lgl, sizeof(INT) );
-        rmq_preprocess(A, LCP, l);
-    #else
-        int_vector<> v(S_n , 0); // Create a vector of length n and initialize it with 0s
-        for ( INT i = 0; i < S_n; i ++ )
-        {
-                v[i] = LCP[i];
-        }
+                choice = planSearch(plans, held_memory, n, shard_to - shard_from, seq_n, reach, previous_index, available);
+                predicted_memory = max(predicted_memory, choice.memory);
+                previous_index = choice.index;
 
-        rmq_succinct_sct<> rmq(&v);
-    #endif
+                string plan_name;
 
-    // Optional printing of data structures
-    if (false) {
-        cout << endl << endl;
-        print_array("  seq", seq, n);
-        print_array("    S", S, S_n, true);
-        print_array("   SA", SA, S_n, true);
-        print_array("invSA", invSA, S_n, true);
-        print_array("  LCP", LCP, S_n, true);
-        cout << endl << endl;
-    }
+                switch (choice.plan) {
+                    case PLAN_NONE: plan_name = "no index (diagonal engine)"; break;
+                    case PLAN_MEMORY: plan_name = "index in memory"; break;
+                    case PLAN_WINDOWED: plan_name = "index in memory, in windows of " + to_string(choice.window) + " centres"; break;
+                    case PLAN_COMPRESSED: plan_name = "compressed index"; break;
+                    case PLAN_DISK: plan_name = "index on disk"; break;
+                    case PLAN_TREE: plan_name = "compressed suffix tree"; break;
+                }
 
-    /////////////////////////////
-    //  CALCULATE PALINDROMES  //
-    /////////////////////////////
+                cout << "Plan for '" << name << "': " << plan_name << ", predicted peak RSS " << (choice.memory + 1024 * 1024 - 1) / (1024 * 1024) << " MB";
+                cout << (choice.memory <= available ? " of " : ", more than the ") << available / (1024 * 1024) << " MB available." << endl;
 
-    set<tuple<int, int, int>> palindromes;
+                // The RMQ structure is chosen at compile time; the other one may hold the index in memory where this one cannot
+                if (choice.plan == PLAN_WINDOWED or choice.plan == PLAN_DISK) {
+                    #ifdef _USE_NLOGN_RMQ
+                        bool sparse = true;
+                    #else
+                        bool sparse = false;
+                    #endif
 
-    // All palindromes calculate and stored
-    #ifdef _USE_NLOGN_RMQ
-        addPalindromes(&palindromes, S, S_n, n, invSA, LCP, A, tuple<int, int, int, int>(min_len, max_len, mismatches, max_gap));
-    #else
-        addPalindromes(&palindromes, S, S_n, n, invSA, LCP, rmq, tuple<int, int, int, int>(min_len, max_len, mismatches, max_gap));
-    #endif
+                    if (held_memory + n + seq_n + previous_index + 2 * seq_n + 2 + inMemoryIndexBytes(seq_n, !sparse) <= available) {
+                        cout << "A build with " << (sparse ? "succinct (rmq2)" : "sparse table (rmq1)") << " RMQ would hold the index of '" << name << "' in memory." << endl;
+                    }
+                }
+            }
 
-    /////////////////////////
-    //  PRINT PALINDROMES  //
-    /////////////////////////
+            traceSequence(number, name);
 
-    ofstream file;
-    file.open(output_file);
+            // Each window is searched as a record of its own, sharing the sequence and the store of its palindromes
+            int windows = (shard_to - shard_from + choice.window - 1) / max(1L, choice.window);
+            windows = max(windows, 1);
+            bool first = true;
+            shared_ptr<ResultStore> results(new ResultStore());
 
-    file << "Palindromes of: " << input_file << endl;
-    file << "Sequence name: " << seq_name << endl;
-    file << "Sequence length is: " << n << endl;
-    file << "Start at position: " << 1 << endl;
-    file << "End at position: " << n << endl;
-    file << "Minimum length of Palindromes is: "  << min_len << endl;
-    file << "Maximum length of Palindromes is: "  << max_len << endl;
-    file << "Maximum gap between elements is: "  << max_gap << endl;
-    file << "Number of mismatches allowed in Palindrome: " << mismatches << endl;
-    file << endl << endl << endl;
-    file << "Palindromes:" << endl;
+            for (int window = 0; window < windows; window++) {
+                long int window_from = shard_from + window * choice.window;
+                long int window_to = (window == windows - 1) ? shard_to : min(shard_to, window_from + choice.window);
 
-    // Dummy entry to ensure all previous palindromes are encountered during sorting
-    palindromes.insert(tuple<int, int, int>(S_n, S_n, 0));
+                // Windows a resumed search has written all palindromes of are skipped
+                bool resumed = (number == resume_records and checkpoint.count("resume_centre") > 0);
+                int resume_centre = resumed ? atoi(checkpoint["resume_centre"].c_str()) : 0;
 
-    if (!palindromes.empty()) {
-        int prev_left = get<0>(*palindromes.begin());
+                if (resumed and windows > 1 and window_to <= resume_centre and window < windows - 1) {
+                    continue;
+                }
 
-        set<tuple<int, int, int>>::iterator it_left_to_right = palindromes.begin();
-        set<tuple<int, int, int>>::iterator it;
+                Record* record = new Record();
+                record->name = name;
+                record->number = number;
+                record->length = n;
+                record->pure_bases = pure_bases;
+                record->shard_from = shard_from;
+                record->shard_to = shard_to;
+                record->offset = offset;
+                record->seq = seq;
+                record->plan = choice.plan;
+                record->window = window;
+                record->windows = windows;
+                record->window_from = window_from;
+                record->window_to = window_to;
+                record->text_offset = (windows > 1) ? max(0L, window_from - reach) : offset;
+                record->n = (windows > 1) ? min(n, window_to + reach) - record->text_offset : seq_n;
+                record->results = results;
+                record->first = first;
+                record->resumed = first and resumed;
+                record->resume_centre = resume_centre;
+                first = false;
+
+                read_records.push(record);
+            }
+        }
 
-        while ( it_left_to_right != palindromes.end() ) {
+        read_records.close();
+    });
 
-        	int left = get<0>(*it_left_to_right);
+    thread indexing([&]() {
+        // Interleaved memory and pinning apply to this thread, which builds every index
+        if (numa and numa_mode == "interleave") {
+            interleaveMemory(nodes);
+        }
 
-            if (prev_left != left) {
-            	it = prev(it_left_to_right);
-            	while (it != prev(palindromes.begin()) and get<0>(*it) == prev_left) {
+        // A replicated index is built on the first node, and copied to the others
+        if (numa and numa_mode == "replicate") {
+            pinToNode(nodes[0]);
+        }
 
-            		int left = get<0>(*it);
-		            int right = get<1>(*it);
-		            int gap = get<2>(*it);
+        Record* record;
 
-		            int outer_left = left + 1;
-		            int outer_right = right + 1;
-		            int inner_left = (outer_left + outer_right - 1 - gap) / 2;
-		            int inner_right = (outer_right + outer_left + 1 + gap) / 2;
+        traceThread("indexing");
 
-		            string pad = "         ";
-		            int pad_length = pad.size();
+        while (read_records.pop(&record)) {
+            TraceScope span("index record", "record", "record", record->number, "window", record->window);
+            indexRecord(record);
+            span.end();
+            indexed_records.push(record);
+        }
 
-		            file << outer_left;
-		            for (int i = 0; i < pad_length - getDigitCount(outer_left); ++i) { file << " "; }
-		            for (int i = outer_left; i <= inner_left; ++i) { file << seq[i - 1]; }
-		            for (int i = 0; i < pad_length - getDigitCount(inner_left); ++i) { file << " "; }
-		            file << inner_left;
+        indexed_records.close();
+    });
 
-		            file << "\n";
+    thread searching([&]() {
+        traceThread("searching");
+        Record* record;
 
-		            file << pad;
-		            for (int i = 0; i < (inner_left - outer_left + 1); ++i) {
-		                file << ( (MatchMatrix::match(seq[ outer_left - 1 + i ], complement[ seq[ outer_right - 1 - i ] ])) ? "|" : " " );
-		            }
+        while (indexed_records.pop(&record)) {
+            ResultStore* results = record->results.get();
+            bool first = record->first;
 
-		            file << "\n";
+            if (first) {
+                results->open(scratch_dir, results_memory * 1024 * 1024, reach, record->window_from);
 
-		            file << outer_right;
-		            for (int i = 0; i < pad_length - getDigitCount(outer_right); ++i) { file << " "; }
-		            for (int i = outer_right; i >= inner_right; --i) { file << seq[i - 1]; }
-		            for (int i = 0; i < pad_length - getDigitCount(inner_right); ++i) { file << " "; }
-		            file << inner_right;
+                if (record->resumed) {
+                    results->resume(record->resume_centre);
+                }
+            }
 
-		            file << "\n" << "\n";
+            results->window(record->text_offset, record->n, record->window_from, record->window_to);
+            record->palindromes.store = results;
 
-            		it--;
-            	}
+            if (first) {
+                searched_records.push(record);
             }
 
-            prev_left = left;
-            it_left_to_right++;
+            TraceScope span("search record", "record", "record", record->number, "window", record->window);
+            searchRecord(record);
+            span.end();
+
+            // Later windows are released here, and the first once its palindromes are written
+            if (!first) {
+                delete record;
+            }
         }
+
+        searched_records.close();
+    });
+
+    Record* record;
+
+    while (searched_records.pop(&record)) {
+        TraceScope span("print record", "record", "record", record->number, "window", record->window);
+        printRecord(&output, record);
+    }
+
+    output.close();
+
+    reading.join();
+    indexing.join();
+    searching.join();
+
+    closeArenaPool(&arena_pool);
+
+    // A finished search leaves no checkpoint to resume from
+    if (checkpoint_file != "") {
+        unlink(checkpoint_file.c_str());
     }
 
-    file << endl << endl << endl;
+    // The peak predicted by the plans is compared with the one reached
+    if (max_memory > 0) {
+        struct rusage resources;
+        getrusage(RUSAGE_SELF, &resources);
+
+        cout << "Peak RSS: predicted " << (predicted_memory + 1024 * 1024 - 1) / (1024 * 1024) << " MB (with up to " << results_memory << " MB more for palindromes held), actual " << resources.ru_maxrss / 1024 << " MB." << endl;
+    }
+
+    if (stats) {
+        writeStats(stderr, false);
+    }
 
-    file.close();
+    if (profile != "" and !writeProfile(profile, chrono::duration<double>(chrono::steady_clock::now() - profile_start).count())) { cout << "Error: Cannot write profile '" + profile + "'." << endl; return -1; }
+    if (trace != "" and !writeTrace(trace)) { cout << "Error: Cannot write trace '" + trace + "'." << endl; return -1; }
 
     cout << "Search complete!" << endl;
 
     free(match_matrix);
-    free(seq);
-    free(SA);
-    free(invSA);
-    free(LCP);
 
     return 0;
 }
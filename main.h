@@ -1,6 +1,7 @@
 #include <divsufsort64.h> // Header for suffix sort
 #include <sdsl/rmq_support.hpp> // Header for Range Minimum Queries
 #include <sdsl/bit_vectors.hpp> // Header for bit vectors
+#include <sdsl/suffix_trees.hpp> // Header for compressed suffix trees
 
 // Enforce use of 64-bit integers if intructed by compiler to do so
 #ifdef _USE_64
@@ -0,0 +1,325 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <tuple>
+#include <algorithm>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+using namespace std;
+
+// Palindrome as its three lines of output, with the order they are printed in: by left index, then from the largest right index
+// and gap down
+struct Entry {
+    string lines;
+    int outer_left;
+    int outer_right;
+    int gap;
+};
+
+// Header of the results of one sequence, with its length and the range of centres searched
+struct Header {
+    vector<string> lines;
+    string name;
+    long int length;
+    long int start;
+    long int end;
+};
+
+
+//////////////////////////////
+//  BASIC HELPER FUNCTIONS  //
+//////////////////////////////
+
+// Prints documentation on usage of IUPACpal-merge arguments
+void usage() {
+    fprintf ( stdout, "\n" );
+    fprintf ( stdout, "  Usage: IUPACpal-merge [-o output_file] shard_file...\n" );
+    fprintf ( stdout, "\n" );
+    fprintf ( stdout, "  FLAG  PARAMETER       TYPE      DEFAULT         DESCRIPTION\n" );
+    fprintf ( stdout, "  -o    output_file     <str>     IUPACpal.out    Output filename (compressed with gzip if ending in .gz).\n" );
+    fprintf ( stdout, "\n" );
+    fprintf ( stdout, "  Shard files are outputs of IUPACpal run with --shard k/N for every k, in any order (read with gzip if compressed).\n" );
+    fprintf ( stdout, "\n" );
+}
+
+// Returns whether a string starts with a prefix
+//
+// INPUT:
+// - String
+// - Prefix
+bool startsWith(const string& text, const string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+
+////////////////////////////
+//  SHARD FILE FUNCTIONS  //
+////////////////////////////
+
+// Output file of one shard, read one line at a time
+struct ShardFile {
+    string filename;
+    gzFile file;
+    string line;
+    bool has_line = false;
+    bool eof = false;
+};
+
+// Reads the next line of a shard file (without its newline), returning false at the end of the file
+//
+// INPUT:
+// - Shard file
+// - Line read
+bool readLine(ShardFile* shard, string* line) {
+    if (shard->has_line) {
+        *line = shard->line;
+        shard->has_line = false;
+        return true;
+    }
+
+    if (shard->eof) {
+        return false;
+    }
+
+    line->clear();
+    char buffer[4096];
+
+    while (gzgets(shard->file, buffer, sizeof(buffer)) != NULL) {
+        line->append(buffer);
+
+        if (!line->empty() and line->back() == '\n') {
+            line->pop_back();
+            return true;
+        }
+    }
+
+    shard->eof = true;
+    return !line->empty();
+}
+
+// Puts back a line, to be read again next
+//
+// INPUT:
+// - Shard file
+// - Line
+void unreadLine(ShardFile* shard, const string& line) {
+    shard->line = line;
+    shard->has_line = true;
+}
+
+// Reads the header of the results of the next sequence in a shard file, returning false at the end of the file
+//
+// INPUT:
+// - Shard file
+// - Header read
+bool readHeader(ShardFile* shard, Header* header) {
+    string line;
+
+    // Skip the blank lines ending the previous sequence
+    do {
+        if (!readLine(shard, &line)) {
+            return false;
+        }
+    } while (line.empty());
+
+    header->lines.clear();
+
+    while (true) {
+        header->lines.push_back(line);
+
+        if (startsWith(line, "Sequence name: ")) {
+            header->name = line.substr(15);
+        }
+        if (startsWith(line, "Sequence length is: ")) {
+            header->length = atol(line.c_str() + 20);
+        }
+        if (startsWith(line, "Start at position: ")) {
+            header->start = atol(line.c_str() + 19);
+        }
+        if (startsWith(line, "End at position: ")) {
+            header->end = atol(line.c_str() + 17);
+        }
+
+        if (line == "Palindromes:") {
+            return true;
+        }
+
+        if (!readLine(shard, &line)) {
+            cout << "Error: File '" << shard->filename << "' ends within a header." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Reads the next palindrome of the current sequence in a shard file, returning false once the sequence has no more
+//
+// INPUT:
+// - Shard file
+// - Palindrome read
+bool readEntry(ShardFile* shard, Entry* entry) {
+    string line;
+
+    do {
+        if (!readLine(shard, &line)) {
+            return false;
+        }
+    } while (line.empty());
+
+    // The header of the next sequence
+    if (startsWith(line, "Palindromes of: ")) {
+        unreadLine(shard, line);
+        return false;
+    }
+
+    string match, right;
+
+    if (!readLine(shard, &match) or !readLine(shard, &right)) {
+        cout << "Error: File '" << shard->filename << "' ends within a palindrome." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Each outer line starts with the outer index, and ends with the inner index
+    int inner_left = atoi(line.c_str() + line.find_last_of(' ') + 1);
+    int inner_right = atoi(right.c_str() + right.find_last_of(' ') + 1);
+
+    entry->outer_left = atoi(line.c_str());
+    entry->outer_right = atoi(right.c_str());
+    entry->gap = inner_right - inner_left - 1;
+    entry->lines = line + "\n" + match + "\n" + right + "\n";
+
+    return true;
+}
+
+
+//////////////////////
+//  MAIN EXECUTION  //
+//////////////////////
+
+int main(int argc, char* argv[]) {
+    string output_file = "IUPACpal.out";
+
+    int c;
+    while( ( c = getopt (argc, argv, "o:") ) != -1 )
+    {
+        switch(c)
+        {
+            case 'o':
+                if(optarg) output_file = optarg;
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if (optind >= argc) { usage(); cout << "Error: No shard files given." << endl; return -1; }
+
+    vector<ShardFile> shards(argc - optind);
+
+    for (size_t i = 0; i < shards.size(); i++) {
+        shards[i].filename = argv[optind + i];
+        shards[i].file = gzopen(shards[i].filename.c_str(), "rb");
+
+        if (shards[i].file == NULL) { usage(); cout << "Error: File '" + shards[i].filename + "' not found." << endl; return -1; }
+    }
+
+    // Written with gzip if the name ends in '.gz', otherwise as plain text
+    bool gzip = (output_file.size() > 3 and output_file.compare(output_file.size() - 3, 3, ".gz") == 0);
+    gzFile output = gzopen(output_file.c_str(), gzip ? "wb" : "wbT");
+
+    if (output == NULL) { usage(); cout << "Error: Cannot write '" + output_file + "'." << endl; return -1; }
+
+    // Shards hold the same sequences in the same order, each under a header of its own
+    while (true) {
+        vector<Header> headers(shards.size());
+        size_t found = 0;
+
+        for (size_t i = 0; i < shards.size(); i++) {
+            found += readHeader(&shards[i], &headers[i]) ? 1 : 0;
+        }
+
+        if (found == 0) {
+            break;
+        }
+
+        if (found < shards.size()) { cout << "Error: Shard files do not hold the same sequences." << endl; return -1; }
+
+        // Shards must cover the sequence from its start to its end, each starting where the previous ended, with all other header
+        // lines alike
+        vector<size_t> order(shards.size());
+
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+
+        // Shards with no centres (when there are more shards than bases) end before they start
+        sort(order.begin(), order.end(), [&](size_t a, size_t b) { return make_pair(headers[a].start, headers[a].end) < make_pair(headers[b].start, headers[b].end); });
+
+        for (size_t i = 1; i < order.size(); i++) {
+            Header& previous = headers[order[i - 1]];
+            Header& header = headers[order[i]];
+
+            if (header.name != previous.name or header.start != previous.end + 1) { cout << "Error: Shard files do not cover sequence '" + header.name + "' once each." << endl; return -1; }
+
+            for (size_t l = 0; l < header.lines.size(); l++) {
+                if (header.lines[l] != previous.lines[l] and !startsWith(header.lines[l], "Start at position: ") and !startsWith(header.lines[l], "End at position: ")) { cout << "Error: Shard files of sequence '" + header.name + "' were searched with different parameters." << endl; return -1; }
+            }
+        }
+
+        // The header of the whole sequence is that of the first shard, ending where the last shard ends
+        Header& first = headers[order.front()];
+        Header& last = headers[order.back()];
+
+        if (first.start != 1 or last.end != first.length) { cout << "Error: Shard files do not cover sequence '" + first.name + "' once each." << endl; return -1; }
+
+        for (string line : first.lines) {
+            if (startsWith(line, "End at position: ")) {
+                line = "End at position: " + to_string(last.end);
+            }
+
+            gzputs(output, (line + "\n").c_str());
+        }
+
+        // Merge the palindromes of all shards in the order they are printed
+        auto later = [](const pair<Entry, size_t>& a, const pair<Entry, size_t>& b) {
+            return make_tuple(a.first.outer_left, -a.first.outer_right, -a.first.gap) > make_tuple(b.first.outer_left, -b.first.outer_right, -b.first.gap);
+        };
+
+        priority_queue< pair<Entry, size_t>, vector< pair<Entry, size_t> >, decltype(later) > heap(later);
+        Entry entry;
+
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (readEntry(&shards[i], &entry)) {
+                heap.push(make_pair(entry, i));
+            }
+        }
+
+        while (!heap.empty()) {
+            size_t i = heap.top().second;
+
+            gzputs(output, heap.top().first.lines.c_str());
+            gzputs(output, "\n");
+            heap.pop();
+
+            if (readEntry(&shards[i], &entry)) {
+                heap.push(make_pair(entry, i));
+            }
+        }
+
+        gzputs(output, "\n\n\n");
+    }
+
+    for (ShardFile& shard : shards) {
+        gzclose(shard.file);
+    }
+
+    if (gzclose(output) != Z_OK) { cout << "Error: Cannot write '" + output_file + "'." << endl; return -1; }
+
+    cout << "Merge complete!" << endl;
+
+    return 0;
+}